@@ -0,0 +1,212 @@
+#include "abbrev.h"
+
+#include <dwarf.h>
+
+#include <algorithm>
+
+#include "leb128.h"
+
+using namespace std;
+
+const Abbrev* AbbrevTable::findSparse(uint64_t number) const {
+  const pair<uint64_t, uint32_t>* end = sparse + num_sparse;
+  const pair<uint64_t, uint32_t>* found =
+    lower_bound(sparse, end, make_pair(number, (uint32_t)0));
+  if (found == end || found->first != number)
+    return NULL;
+  return &abbrevs[found->second];
+}
+
+// Returns the encoded size of |form|, or -1 if it has to be decoded to
+// know its size. DWARF-zip stores 4-byte values and 8-byte addresses as
+// SLEB128.
+static int getFixedFormSize(uint8_t form, uint8_t ptrsize,
+                            uint8_t ref_addr_size, bool is_zipped) {
+  switch (form) {
+  case DW_FORM_ref_addr:
+    if (ref_addr_size != ptrsize)
+      return is_zipped ? -1 : ref_addr_size;
+    // Fall through.
+  case DW_FORM_addr:
+    if (is_zipped && ptrsize == 8)
+      return -1;
+    return ptrsize;
+
+  case DW_FORM_data1:
+  case DW_FORM_ref1:
+  case DW_FORM_flag:
+    return 1;
+
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+    return 2;
+
+  case DW_FORM_strp:
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_sec_offset:
+    return is_zipped ? -1 : 4;
+
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+    return 8;
+
+  case DW_FORM_flag_present:
+    return 0;
+
+  default:
+    return -1;
+  }
+}
+
+// Whether the skip loop in the scanner knows how to step over |form|.
+static bool isSkippableForm(uint8_t form, uint8_t ptrsize,
+                            uint8_t ref_addr_size, bool is_zipped) {
+  switch (form) {
+  case DW_FORM_ref_addr:
+    if (ref_addr_size != ptrsize)
+      return true;
+    // Fall through.
+  case DW_FORM_addr:
+    return ptrsize == 2 || ptrsize == 4 || ptrsize == 8;
+
+  case DW_FORM_strp:
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_sec_offset:
+  case DW_FORM_block1:
+  case DW_FORM_block2:
+  case DW_FORM_block4:
+  case DW_FORM_block:
+  case DW_FORM_exprloc:
+  case DW_FORM_string:
+  case DW_FORM_sdata:
+  case DW_FORM_udata:
+    return true;
+
+  default:
+    return getFixedFormSize(form, ptrsize, ref_addr_size, is_zipped) >= 0;
+  }
+}
+
+AbbrevCache::AbbrevCache(const uint8_t* debug_abbrev, bool is_zipped)
+  : debug_abbrev_(debug_abbrev),
+    is_zipped_(is_zipped) {
+}
+
+AbbrevTable AbbrevCache::get(uint32_t offset, uint8_t ptrsize,
+                             uint16_t version) {
+  uint8_t ref_addr_size = getRefAddrSize(version, ptrsize);
+  uint64_t key = ((uint64_t)ref_addr_size << 40 | (uint64_t)ptrsize << 32 |
+                  offset);
+  unordered_map<uint64_t, TableIndex>::const_iterator found =
+    tables_.find(key);
+  if (found == tables_.end()) {
+    found = tables_.insert(
+        make_pair(key, parse(offset, ptrsize, ref_addr_size))).first;
+  }
+
+  const TableIndex& index = found->second;
+  AbbrevTable table;
+  table.dense = abbrevs_.data() + index.abbrev_begin;
+  table.num_dense = index.num_dense;
+  table.sparse = sparse_.data() + index.sparse_begin;
+  table.num_sparse = index.num_sparse;
+  table.abbrevs = abbrevs_.data();
+  table.attrs = attrs_.data();
+  table.skips = skips_.data();
+  return table;
+}
+
+AbbrevCache::TableIndex AbbrevCache::parse(uint32_t offset,
+                                           uint8_t ptrsize,
+                                           uint8_t ref_addr_size) {
+  TableIndex index;
+  index.abbrev_begin = abbrevs_.size();
+  index.num_dense = 0;
+  index.sparse_begin = sparse_.size();
+  index.num_sparse = 0;
+
+  const uint8_t* p = debug_abbrev_ + offset;
+  while (true) {
+    uint64_t number = uleb128(p);
+    if (!number)
+      break;
+
+    Abbrev abbrev;
+    abbrev.tag = uleb128(p);
+    abbrev.has_children = *p++;
+    abbrev.attr_begin = attrs_.size();
+    while (true) {
+      Attr attr;
+      attr.name = uleb128(p);
+      attr.form = *p++;
+      //printf("abbrev attr parsed: %x %x\n", attr.name, attr.form);
+      if (!attr.name)
+        break;
+      attrs_.push_back(attr);
+    }
+    abbrev.num_attrs = attrs_.size() - abbrev.attr_begin;
+    buildSkipPlan(&abbrev, ptrsize, ref_addr_size);
+    //printf("abbrev parsed: %d %d %d\n",
+    //       abbrev.tag, abbrev.has_children, (int)abbrev.num_attrs);
+
+    // Codes are almost always 1, 2, 3, ... so they index the dense part
+    // directly. Anything after the first gap is looked up by binary search.
+    if (index.num_sparse == 0 && number == index.num_dense + 1) {
+      index.num_dense++;
+    } else {
+      sparse_.push_back(make_pair(number, (uint32_t)abbrevs_.size()));
+      index.num_sparse++;
+    }
+    abbrevs_.push_back(abbrev);
+  }
+
+  sort(sparse_.begin() + index.sparse_begin, sparse_.end());
+  return index;
+}
+
+void AbbrevCache::buildSkipPlan(Abbrev* abbrev, uint8_t ptrsize,
+                                uint8_t ref_addr_size) {
+  abbrev->can_skip = true;
+  abbrev->skip_begin = skips_.size();
+  abbrev->sibling_offset = -1;
+  abbrev->sibling_form = 0;
+  uint32_t fixed = 0;
+  for (uint32_t i = 0; i < abbrev->num_attrs; i++) {
+    const Attr& attr = attrs_[abbrev->attr_begin + i];
+    uint8_t form = attr.form;
+    if (!isSkippableForm(form, ptrsize, ref_addr_size, is_zipped_)) {
+      abbrev->can_skip = false;
+      break;
+    }
+    // Offsets in DWARF-zip data no longer match the layout, so siblings
+    // are only usable in plain binaries.
+    if (attr.name == DW_AT_sibling && !is_zipped_ &&
+        abbrev->skip_begin == skips_.size() &&
+        (form == DW_FORM_ref1 || form == DW_FORM_ref2 ||
+         form == DW_FORM_ref4 || form == DW_FORM_ref8)) {
+      abbrev->sibling_offset = fixed;
+      abbrev->sibling_form = form;
+    }
+    int size = getFixedFormSize(form, ptrsize, ref_addr_size, is_zipped_);
+    if (size >= 0) {
+      fixed += size;
+      continue;
+    }
+    SkipStep step;
+    step.fixed = fixed;
+    step.form = form;
+    skips_.push_back(step);
+    fixed = 0;
+  }
+  if (abbrev->can_skip && fixed) {
+    SkipStep step;
+    step.fixed = fixed;
+    step.form = 0;
+    skips_.push_back(step);
+  }
+  if (!abbrev->can_skip)
+    skips_.resize(abbrev->skip_begin);
+  abbrev->num_skips = skips_.size() - abbrev->skip_begin;
+}
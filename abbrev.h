@@ -0,0 +1,111 @@
+#ifndef ABBREV_H_
+#define ABBREV_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// DW_FORM_ref_addr is an address in DWARF 2 and an offset since DWARF 3,
+// which is 4 bytes as 64-bit DWARF is not supported.
+static inline uint8_t getRefAddrSize(uint16_t version, uint8_t ptrsize) {
+  return version <= 2 ? ptrsize : 4;
+}
+
+struct Attr {
+  uint16_t name;
+  uint8_t form;
+};
+
+// Advances over |fixed| bytes, then over one value of the variable-size
+// |form|, or nothing when |form| is 0.
+struct SkipStep {
+  uint32_t fixed;
+  uint8_t form;
+};
+
+struct Abbrev {
+  uint16_t tag;
+  bool has_children;
+  // False if some form has no known size, in which case the DIE must go
+  // through the full decoder.
+  bool can_skip;
+  uint32_t num_attrs;
+  // Index of the first attribute in AbbrevTable::attrs.
+  uint32_t attr_begin;
+  // The skip plan of this DIE in AbbrevTable::skips.
+  uint32_t num_skips;
+  uint32_t skip_begin;
+  // Where the DW_AT_sibling value sits relative to the first attribute, or
+  // -1 if it is absent or comes after a variable-size form.
+  int32_t sibling_offset;
+  uint8_t sibling_form;
+};
+
+// One .debug_abbrev table as seen by a CU. Codes 1..num_dense are looked up
+// by index; any code that breaks the sequence goes to a sorted side list.
+// A table points into its AbbrevCache and stays valid until the cache
+// parses another table.
+struct AbbrevTable {
+  const Abbrev* dense;
+  size_t num_dense;
+  const std::pair<uint64_t, uint32_t>* sparse;
+  size_t num_sparse;
+  const Abbrev* abbrevs;
+  const Attr* attrs;
+  const SkipStep* skips;
+
+  const Abbrev* find(uint64_t number) const {
+    if (number - 1 < num_dense)
+      return &dense[number - 1];
+    return findSparse(number);
+  }
+
+  const Attr* getAttrs(const Abbrev* abbrev) const {
+    return attrs + abbrev->attr_begin;
+  }
+
+  const SkipStep* getSkips(const Abbrev* abbrev) const {
+    return skips + abbrev->skip_begin;
+  }
+
+private:
+  const Abbrev* findSparse(uint64_t number) const;
+};
+
+// Parsed abbreviation tables keyed by their .debug_abbrev offset. Linked
+// binaries share one table between many CUs, so each is parsed once. All
+// tables live in a few flat arrays. Skip plans depend on the address size
+// and the DW_FORM_ref_addr size of the CU, so a table used with two of
+// them is parsed twice.
+class AbbrevCache {
+public:
+  AbbrevCache(const uint8_t* debug_abbrev, bool is_zipped);
+
+  // Parses the table at |offset| unless it is already cached. |version|
+  // is the DWARF version of the CU.
+  AbbrevTable get(uint32_t offset, uint8_t ptrsize, uint16_t version);
+
+private:
+  struct TableIndex {
+    uint32_t abbrev_begin;
+    uint32_t num_dense;
+    uint32_t sparse_begin;
+    uint32_t num_sparse;
+  };
+
+  TableIndex parse(uint32_t offset, uint8_t ptrsize, uint8_t ref_addr_size);
+  void buildSkipPlan(Abbrev* abbrev, uint8_t ptrsize, uint8_t ref_addr_size);
+
+  const uint8_t* debug_abbrev_;
+  bool is_zipped_;
+  std::unordered_map<uint64_t, TableIndex> tables_;
+  std::vector<Abbrev> abbrevs_;
+  std::vector<Attr> attrs_;
+  std::vector<SkipStep> skips_;
+  std::vector<std::pair<uint64_t, uint32_t> > sparse_;
+};
+
+#endif  // ABBREV_H_
@@ -1,6 +1,6 @@
 #include "binary.h"
 
-#include <err.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -13,6 +13,9 @@
 
 #include <elf.h>
 
+#include "leb128.h"
+#include "util.h"
+
 #define Elf_Ehdr Elf64_Ehdr
 #define Elf_Shdr Elf64_Shdr
 
@@ -32,6 +35,28 @@ Binary::Binary(int fd, char* p, size_t sz, size_t msz)
     fd_(fd) {
 }
 
+Binary::~Binary() {
+  munmap(mapped_head, mapped_size);
+  close(fd_);
+}
+
+bool Binary::contains(const char* pos, size_t len) const {
+  const char* end = mapped_head + size;
+  return pos >= mapped_head && pos <= end && len <= (size_t)(end - pos);
+}
+
+// Sections usually have other data after them, but one which ends the
+// file may end within the overread of the last page.
+void Binary::padSection(const char** section, size_t len) {
+  if (*section + len + kLEB128Overread <= mapped_head + mapped_size)
+    return;
+  char* copy = new char[len + kLEB128Overread];
+  padded_sections_.emplace_back(copy);
+  memcpy(copy, *section, len);
+  memset(copy + len, 0, kLEB128Overread);
+  *section = copy;
+}
+
 static bool isDwarfZip(char* p) {
   return !strncmp(p, "\xdfZIP", 4);
 }
@@ -69,16 +94,25 @@ public:
 
     Elf_Ehdr* ehdr = (Elf_Ehdr*)p;
     if (!ehdr->e_shoff || !ehdr->e_shnum)
-      err(1, "no section header: %s", filename);
+      throwError("no section header: %s", filename);
     if (!ehdr->e_shstrndx)
-      err(1, "no section name: %s", filename);
+      throwError("no section name: %s", filename);
 
     Elf_Shdr* shdr = (Elf_Shdr*)(p + ehdr->e_shoff - reduced_size);
-    const char* shstr = (const char*)(p + shdr[ehdr->e_shstrndx].sh_offset);
+    if (!contains((const char*)shdr, ehdr->e_shnum * sizeof(Elf_Shdr)) ||
+        ehdr->e_shstrndx >= ehdr->e_shnum)
+      throwError("broken section header: %s", filename);
+    const Elf_Shdr& shstr_sec = shdr[ehdr->e_shstrndx];
+    const char* shstr = (const char*)(p + shstr_sec.sh_offset);
     shstr -= reduced_size;
+    if (!contains(shstr, shstr_sec.sh_size) || !shstr_sec.sh_size ||
+        shstr[shstr_sec.sh_size - 1])
+      throwError("broken section names: %s", filename);
     bool debug_info_seen = false;
     for (int i = 0; i < ehdr->e_shnum; i++) {
       Elf_Shdr* sec = shdr + i;
+      if (sec->sh_name >= shstr_sec.sh_size)
+        throwError("broken section names: %s", filename);
       const char* pos = p + sec->sh_offset;
       if (debug_info_seen)
         pos -= reduced_size;
@@ -97,14 +131,18 @@ public:
     }
 
     if (!debug_info || !debug_abbrev || !debug_str)
-      err(1, "no debug info: %s", filename);
-  }
-
-  ~ELFBinary() {
-    munmap(head, mapped_size);
-    close(fd_);
+      throwError("no debug info: %s", filename);
+    if (!contains(debug_info, debug_info_len) ||
+        !contains(debug_abbrev, debug_abbrev_len) ||
+        !contains(debug_str, debug_str_len))
+      throwError("debug sections out of the file: %s", filename);
+    if (!debug_str_len || debug_str[debug_str_len - 1])
+      throwError("unterminated .debug_str: %s", filename);
+    padSection(&debug_info, debug_info_len);
+    padSection(&debug_abbrev, debug_abbrev_len);
   }
 
+  // Returns 0 for non-ELF files and -1 for unknown ELF classes.
   static int getELFBit(const char* p) {
     if (strncmp(p, ELFMAG, SELFMAG))
       return 0;
@@ -112,7 +150,7 @@ public:
       return 64;
     if (p[EI_CLASS] == ELFCLASS32)
       return 32;
-    err(1, "Unknown ELF class");
+    return -1;
   }
 };
 
@@ -174,7 +212,7 @@ public:
     }
 
     if (!debug_info || !debug_abbrev || !debug_str)
-      err(1, "no debug info: %s", filename);
+      throwError("no debug info: %s", filename);
   }
 
   static bool isMachO(const char* p) {
@@ -183,7 +221,7 @@ public:
       return true;
     }
     if (header->magic == MH_MAGIC) {
-      err(1, "non 64bit Mach-O isn't supported yet");
+      throwError("non 64bit Mach-O isn't supported yet");
     }
     return false;
   }
@@ -194,34 +232,42 @@ public:
 Binary* readBinary(const char* filename) {
   int fd = open(filename, O_RDONLY);
   if (fd < 0)
-    err(1, "open failed: %s", filename);
+    throwError("open failed: %s: %s", filename, strerror(errno));
 
   size_t size = lseek(fd, 0, SEEK_END);
-  if (size < 8 + 16)
-    err(1, "too small file: %s", filename);
+  if (size < 8 + 16) {
+    close(fd);
+    throwError("too small file: %s", filename);
+  }
 
   size_t mapped_size = (size + 0xfff) & ~0xfff;
 
   char* p = (char*)mmap(NULL, mapped_size,
                         PROT_READ, MAP_SHARED,
                         fd, 0);
-  if (p == MAP_FAILED)
-    err(1, "mmap failed: %s", filename);
+  if (p == MAP_FAILED) {
+    int e = errno;
+    close(fd);
+    throwError("mmap failed: %s: %s", filename, strerror(e));
+  }
 
+  // Once the Binary is constructed, its destructor unmaps and closes.
   char* header = p;
   if (isDwarfZip(header)) {
     header += 8;
   }
   int elf_bit = ELFBinary<32>::getELFBit(header);
-  if (elf_bit) {
-    if (elf_bit == 32)
-      return new ELFBinary<32>(filename, fd, p, size, mapped_size);
-    else
-      return new ELFBinary<64>(filename, fd, p, size, mapped_size);
+  if (elf_bit == 32)
+    return new ELFBinary<32>(filename, fd, p, size, mapped_size);
+  if (elf_bit == 64)
+    return new ELFBinary<64>(filename, fd, p, size, mapped_size);
 #if 0
-  } else if (MachOBinary::isMachO(header)) {
+  if (MachOBinary::isMachO(header))
     return new MachOBinary(filename, fd, p, size, mapped_size);
 #endif
-  }
-  err(1, "unknown file format: %s", filename);
+  munmap(p, mapped_size);
+  close(fd);
+  if (elf_bit < 0)
+    throwError("Unknown ELF class: %s", filename);
+  throwError("unknown file format: %s", filename);
 }
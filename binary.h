@@ -3,9 +3,13 @@
 
 #include <stdio.h>
 
+#include <memory>
+#include <vector>
+
 class Binary {
 public:
   Binary(int fd, char* p, size_t sz, size_t msz);
+  virtual ~Binary();
 
   char* head;
   size_t size;
@@ -21,9 +25,17 @@ public:
   size_t reduced_size;
 
 protected:
+  // Whether the |len| bytes at |pos| are all in the file.
+  bool contains(const char* pos, size_t len) const;
+  // Copies the section at |*section| when fewer than kLEB128Overread bytes
+  // of the mapping follow it, and points |*section| at the copy.
+  void padSection(const char** section, size_t len);
+
   int fd_;
+  std::vector<std::unique_ptr<char[]> > padded_sections_;
 };
 
+// Throws CrefError if |filename| cannot be read.
 Binary* readBinary(const char* filename);
 
 #endif  // BINARY_H_
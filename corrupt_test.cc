@@ -0,0 +1,154 @@
+// Feeds corrupted copies of a binary through the library and expects each
+// to be rejected with a CrefError instead of crashing.
+//
+// Usage: ./corrupt_test binary tmpfile
+
+#include <dwarf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binary.h"
+#include "dumper.h"
+#include "scanner.h"
+#include "util.h"
+
+using namespace std;
+
+// Finds the .debug_info offset of the first struct name in .debug_str,
+// which the dumper reads.
+class StrpFinder : public StaticScanner<StrpFinder> {
+public:
+  explicit StrpFinder(Binary* binary)
+    : StaticScanner<StrpFinder>(binary),
+      strp_offset(0) {
+  }
+
+  uint64_t strp_offset;
+
+private:
+  friend class StaticScanner<StrpFinder>;
+
+  void onCU(CU* /*cu*/, uint64_t /*offset*/) {
+  }
+
+  bool onAbbrev(uint16_t tag, uint64_t /*number*/, uint64_t /*offset*/) {
+    return tag == DW_TAG_structure_type && !strp_offset;
+  }
+
+  void onAbbrevDone() {
+  }
+
+  void onAttr(uint16_t name, uint8_t form,
+              uint64_t /*value*/, uint64_t offset) {
+    if (name == DW_AT_name && form == DW_FORM_strp && !strp_offset)
+      strp_offset = offset;
+  }
+};
+
+static vector<char> readFile(const char* filename) {
+  FILE* fp = fopen(filename, "rb");
+  if (!fp)
+    throwError("open failed: %s", filename);
+  vector<char> buf;
+  char chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+    buf.insert(buf.end(), chunk, chunk + n);
+  fclose(fp);
+  return buf;
+}
+
+static void writeFile(const char* filename, const vector<char>& buf) {
+  FILE* fp = fopen(filename, "wb");
+  if (!fp)
+    throwError("open failed: %s", filename);
+  fwrite(buf.data(), 1, buf.size(), fp);
+  if (fclose(fp))
+    throwError("write failed: %s", filename);
+}
+
+// Dumps |filename| with |num_threads| and returns the error, or "" if the
+// dump succeeded.
+static string dumpError(const char* filename, int num_threads, bool stream) {
+  try {
+    unique_ptr<Binary> binary(readBinary(filename));
+    DumpDebugScanner scanner(binary.get());
+    FILE* out = fopen("/dev/null", "w");
+    if (stream)
+      scanner.setStreamOutput(out);
+    scanner.runBatched(num_threads);
+    scanner.dump(out);
+    fclose(out);
+  } catch (const CrefError& e) {
+    return e.what();
+  }
+  return "";
+}
+
+// Writes |buf| to |tmp| and checks that every mode rejects it.
+static bool expectError(const char* name, const vector<char>& buf,
+                        const char* tmp) {
+  writeFile(tmp, buf);
+  bool ok = true;
+  static const int kThreads[] = { 1, 4 };
+  for (size_t i = 0; i < 2; i++) {
+    for (int stream = 0; stream < 2; stream++) {
+      string error = dumpError(tmp, kThreads[i], stream);
+      if (error.empty()) {
+        fprintf(stderr, "FAIL %s: -j%d%s was not rejected\n",
+                name, kThreads[i], stream ? " --stream" : "");
+        ok = false;
+      }
+    }
+  }
+  if (ok)
+    printf("PASS %s\n", name);
+  return ok;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s binary tmpfile\n", argv[0]);
+    exit(1);
+  }
+
+  try {
+    vector<char> orig = readFile(argv[1]);
+    unique_ptr<Binary> binary(readBinary(argv[1]));
+    StrpFinder finder(binary.get());
+    finder.run();
+    if (!finder.strp_offset)
+      throwError("no struct named in .debug_str: %s", argv[1]);
+    uint64_t dinfo = binary->debug_info - binary->mapped_head;
+    uint64_t dinfo_len = binary->debug_info_len;
+    if (!dumpError(argv[1], 1, false).empty())
+      throwError("%s is not dumped as it is", argv[1]);
+
+    bool ok = true;
+    vector<char> buf = orig;
+    buf.resize(dinfo + dinfo_len / 2);
+    ok &= expectError("truncated .debug_info", buf, argv[2]);
+
+    buf = orig;
+    uint32_t length = dinfo_len * 2;
+    memcpy(&buf[dinfo], &length, sizeof(length));
+    ok &= expectError("CU length past .debug_info", buf, argv[2]);
+
+    buf = orig;
+    uint32_t strp = 0xfffffff0;
+    memcpy(&buf[dinfo + finder.strp_offset], &strp, sizeof(strp));
+    ok &= expectError("strp past .debug_str", buf, argv[2]);
+
+    if (!ok)
+      exit(1);
+  } catch (const CrefError& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+}
@@ -0,0 +1,104 @@
+#ifndef DIE_BATCH_H_
+#define DIE_BATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string_view>
+#include <vector>
+
+// A decoded attribute. Strings and blocks point into the mapped binary.
+struct AttrValue {
+  enum Kind {
+    CONSTANT,
+    ADDRESS,
+    // A .debug_info offset, already made absolute for CU relative forms.
+    REFERENCE,
+    SEC_OFFSET,
+    FLAG,
+    // A NUL terminated string, from .debug_str or inline.
+    STRING,
+    BLOCK,
+  };
+
+  uint16_t name;
+  uint8_t form;
+  uint8_t kind;
+  // The value for scalar kinds, the size for BLOCK and 0 for STRING.
+  uint64_t value;
+  // The bytes of STRING and BLOCK.
+  const char* data;
+
+  std::string_view str() const {
+    return std::string_view(data);
+  }
+};
+
+struct DIERecord {
+  // The .debug_info offset of the DIE.
+  uint64_t offset;
+  const AttrValue* attrs;
+  uint32_t num_attrs;
+  uint16_t tag;
+  // The tag of the DIE scanned right before this one in the same CU, which
+  // may be one nobody wanted, or 0 for the first DIE. DIEs in skipped
+  // subtrees are never scanned.
+  uint16_t prev_tag;
+  // 0 for the CU DIE.
+  uint16_t depth;
+  bool has_children;
+
+  const AttrValue* find(uint16_t name) const {
+    for (uint32_t i = 0; i < num_attrs; i++) {
+      if (attrs[i].name == name)
+        return &attrs[i];
+    }
+    return NULL;
+  }
+};
+
+// Up to kMaxDIEs DIEs of one CU with all their attributes in one array.
+class DIEBatch {
+public:
+  static const size_t kMaxDIEs = 1024;
+
+  size_t size() const { return dies_.size(); }
+  bool full() const { return dies_.size() >= kMaxDIEs; }
+  const DIERecord& operator[](size_t i) const { return dies_[i]; }
+
+  void clear() {
+    dies_.clear();
+    attr_begins_.clear();
+    attrs_.clear();
+  }
+
+  // The attributes of the new DIE are NULL until seal(), as attrs_ may
+  // still move.
+  DIERecord* addDIE() {
+    dies_.push_back(DIERecord());
+    attr_begins_.push_back(attrs_.size());
+    DIERecord* die = &dies_.back();
+    die->attrs = NULL;
+    die->num_attrs = 0;
+    return die;
+  }
+
+  void addAttr(const AttrValue& attr) {
+    attrs_.push_back(attr);
+    dies_.back().num_attrs++;
+  }
+
+  // Points the DIEs at their attributes, once nothing is added anymore.
+  void seal() {
+    for (size_t i = 0; i < dies_.size(); i++)
+      dies_[i].attrs = attrs_.data() + attr_begins_[i];
+  }
+
+private:
+  std::vector<DIERecord> dies_;
+  // Where the attributes of each DIE start in attrs_.
+  std::vector<uint32_t> attr_begins_;
+  std::vector<AttrValue> attrs_;
+};
+
+#endif  // DIE_BATCH_H_
@@ -0,0 +1,73 @@
+#include "die_store.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// DIEStore only implements the callbacks of runBatched().
+template void StaticScanner<DIEStore>::runBatched(int num_threads);
+
+DIEStore::DIEStore(Binary* binary, const vector<uint16_t>& attr_names)
+  : StaticScanner<DIEStore>(binary) {
+  for (size_t i = 0; i < attr_names.size(); i++) {
+    uint16_t name = attr_names[i];
+    if (name >= column_index_.size())
+      column_index_.resize(name + 1, -1);
+    if (column_index_[name] >= 0)
+      continue;
+    column_index_[name] = columns_.size();
+    columns_.push_back(Column());
+    columns_.back().name = name;
+  }
+}
+
+void DIEStore::build(int num_threads) {
+  runBatched(num_threads);
+}
+
+const DIEStore::Column* DIEStore::column(uint16_t name) const {
+  if (name >= column_index_.size() || column_index_[name] < 0)
+    return NULL;
+  return &columns_[column_index_[name]];
+}
+
+void DIEStore::countChildren(uint16_t tag, vector<uint32_t>* counts) const {
+  counts->assign(size(), 0);
+  for (size_t i = 0; i < size(); i++) {
+    if (tags_[i] == tag && parents_[i] != NONE)
+      (*counts)[parents_[i]]++;
+  }
+}
+
+void DIEStore::onCU(CU* /*cu*/, uint64_t /*offset*/) {
+  path_.clear();
+}
+
+void DIEStore::onDIEs(const DIEBatch& batch) {
+  for (size_t i = 0; i < batch.size(); i++) {
+    const DIERecord& die = batch[i];
+    uint32_t index = tags_.size();
+    path_.resize(min<size_t>(path_.size(), die.depth));
+    uint32_t parent = path_.empty() ? NONE : path_.back();
+    tags_.push_back(die.tag);
+    parents_.push_back(parent);
+    depths_.push_back(die.depth);
+    offsets_.push_back(die.offset);
+    path_.push_back(index);
+
+    uint8_t absent = Column::ABSENT;
+    for (size_t j = 0; j < columns_.size(); j++) {
+      columns_[j].values.push_back(0);
+      columns_[j].kinds.push_back(absent);
+    }
+    for (uint32_t j = 0; j < die.num_attrs; j++) {
+      const AttrValue& attr = die.attrs[j];
+      if (attr.name >= column_index_.size() || column_index_[attr.name] < 0)
+        continue;
+      Column* column = &columns_[column_index_[attr.name]];
+      column->kinds[index] = attr.kind;
+      column->values[index] = (attr.kind == AttrValue::STRING ?
+                               (uint64_t)(uintptr_t)attr.data : attr.value);
+    }
+  }
+}
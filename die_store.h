@@ -0,0 +1,77 @@
+#ifndef DIE_STORE_H_
+#define DIE_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "die_batch.h"
+#include "scanner.h"
+
+// All DIEs of a binary from one scan, kept as one array per field, so
+// that queries over them are loops over plain arrays instead of new
+// scans. DIEs are numbered in .debug_info order. Only the attributes
+// asked for are kept, in a column each.
+class DIEStore : public StaticScanner<DIEStore> {
+public:
+  static const uint32_t NONE = 0xffffffff;
+
+  // One attribute of all DIEs. kinds[i] is the AttrValue::Kind of the
+  // value of DIE i, or ABSENT. values[i] is its AttrValue::value, except
+  // that it is the address of the string for STRING, which points into the
+  // binary. Blocks only keep their size.
+  struct Column {
+    static const uint8_t ABSENT = 0xff;
+
+    bool has(uint32_t i) const { return kinds[i] != ABSENT; }
+    const char* str(uint32_t i) const {
+      return (kinds[i] == AttrValue::STRING ?
+              (const char*)(uintptr_t)values[i] : NULL);
+    }
+
+    uint16_t name;
+    std::vector<uint64_t> values;
+    std::vector<uint8_t> kinds;
+  };
+
+  // |attr_names| are the DW_AT_* values to keep columns for.
+  DIEStore(Binary* binary, const std::vector<uint16_t>& attr_names);
+
+  // Scans the binary into the store, like runBatched(num_threads).
+  void build(int num_threads);
+
+  size_t size() const { return tags_.size(); }
+  const uint16_t* tags() const { return tags_.data(); }
+  // The index of the DIE each DIE is a child of, or NONE for CU DIEs.
+  const uint32_t* parents() const { return parents_.data(); }
+  // 0 for CU DIEs.
+  const uint16_t* depths() const { return depths_.data(); }
+  const uint64_t* offsets() const { return offsets_.data(); }
+
+  // The column of |name|, or NULL if it was not asked for.
+  const Column* column(uint16_t name) const;
+
+  // Sets (*counts)[i] to how many children with |tag| DIE i has.
+  void countChildren(uint16_t tag, std::vector<uint32_t>* counts) const;
+
+private:
+  friend class StaticScanner<DIEStore>;
+
+  void onCU(CU* cu, uint64_t offset);
+  void onDIEs(const DIEBatch& batch);
+
+  std::vector<uint16_t> tags_;
+  std::vector<uint32_t> parents_;
+  std::vector<uint16_t> depths_;
+  std::vector<uint64_t> offsets_;
+  std::vector<Column> columns_;
+  // Indices of columns_ by attribute name, or -1.
+  std::vector<int> column_index_;
+  // The DIEs from the CU DIE down to the parent of the next one.
+  std::vector<uint32_t> path_;
+};
+
+extern template void StaticScanner<DIEStore>::runBatched(int);
+
+#endif  // DIE_STORE_H_
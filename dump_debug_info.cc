@@ -1,553 +1,398 @@
-#define __STDC_FORMAT_MACROS
-#include <assert.h>
-#include <dwarf.h>
-#include <err.h>
-#include <fcntl.h>
-#include <inttypes.h>
-#include <stdarg.h>
-#include <stdint.h>
+#include <dirent.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
+#include <time.h>
 
-#include <map>
+#include <algorithm>
+#include <condition_variable>
 #include <memory>
-#include <set>
-#include <stack>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "binary.h"
-#include "scanner.h"
+#include "dumper.h"
+#include "json_writer.h"
+#include "thread_pool.h"
+#include "util.h"
 
 using namespace std;
 
-static uint64_t offset_;
-
-#define CHECK(c, ...) if (!(c)) error(__VA_ARGS__)
-
-void reportImpl(const char* fmt, va_list ap) {
-  char* str;
-  vasprintf(&str, fmt, ap);
-  fprintf(stderr, "%"PRIx64": %s\n", offset_, str);
-  free(str);
-}
-
-void report(const char* fmt, ...) {
-  va_list ap;
-  va_start(ap, fmt);
-  reportImpl(fmt, ap);
-  va_end(ap);
-}
-
-void error(const char* fmt, ...) {
-  va_list ap;
-  va_start(ap, fmt);
-  reportImpl(fmt, ap);
-  va_end(ap);
-  abort();
-}
-
-string stringPrintf(const char* fmt, ...) {
-  va_list ap;
-  va_start(ap, fmt);
-  char* str;
-  vasprintf(&str, fmt, ap);
-  va_end(ap);
-  string ret(str);
-  free(str);
-  return ret;
-}
-
-static const uint64_t VAARG_OFFSET = (uint64_t)-1;
-
-bool isSpecialTypeOffset(uint64_t offset) {
-  return offset == 0 || offset == VAARG_OFFSET;
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
 }
 
-struct Type {
-  enum {
-    TYPE_ERROR, TYPE_BASE, TYPE_TYPEDEF, TYPE_STRUCT,
-    TYPE_POINTER, TYPE_ARRAY, TYPE_CONST, TYPE_VOLATILE, TYPE_FUNC
-  };
-  int type;
-  int size;
-  const char* name;
-  uint64_t ref;
-  int cu_id;
-  uint64_t offset;
-  Type* ref_type;
-
-  Type(int t)
-    : type(t), ref(0), ref_type(NULL) {}
-  Type(int t, int s, const char* n)
-    : type(t), size(s), name(n), ref(0), ref_type(NULL) {}
-  Type(int t, const char* n, uint64_t r)
-    : type(t), name(n), ref(r), ref_type(NULL) {}
-
-  int getSize() const {
-    if (size)
-      return size;
-    if (type == TYPE_TYPEDEF || type == TYPE_CONST || type == TYPE_VOLATILE)
-      return ref_type->getSize();
-    return 0;
-  }
-
-  string getJson() const {
-    offset_ = offset;
-    switch (type) {
-    case TYPE_BASE:
-      CHECK(size, "Uknkown size for base");
-      return stringPrintf("[\"base\", %d]", size);
-    case TYPE_TYPEDEF:
-      return stringPrintf("[\"typedef\", \"%s\"]", getName().c_str());
-    case TYPE_STRUCT:
-      return stringPrintf("[\"struct\", %d]", size);
-    default:
-      CHECK(false, "Unsupported type: %d", type);
+// The regular files in the directory |list|, or the paths listed one per
+// line in the file |list|, or in stdin for "-".
+static vector<string> readInputs(const char* list) {
+  vector<string> inputs;
+  struct stat st;
+  if (strcmp(list, "-") && !stat(list, &st) && S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(list);
+    if (!dir)
+      throwError("opendir failed: %s", list);
+    while (struct dirent* ent = readdir(dir)) {
+      string path = string(list) + '/' + ent->d_name;
+      if (!stat(path.c_str(), &st) && S_ISREG(st.st_mode))
+        inputs.push_back(path);
     }
-    return "???";
+    closedir(dir);
+    sort(inputs.begin(), inputs.end());
+    return inputs;
   }
 
-  string getName() const {
-    offset_ = offset;
-    switch (type) {
-    case TYPE_BASE:
-      return name;
-    case TYPE_TYPEDEF:
-      // CHECK(ref_type, "Unresolved ref");
-      // TODO(hamaji): OK?
-      return ref_type ? ref_type->getName() : "<anonymous>";
-    case TYPE_STRUCT:
-      if (!name)
-        return "<anonymous>";
-      return name;
-    case TYPE_POINTER:
-      if (!ref_type)
-        return "void*";
-      return ref_type->getName() + '*';
-    case TYPE_ARRAY:
-      CHECK(ref_type, "Unresolved ref");
-      return ref_type->getName() + "[]";
-    case TYPE_CONST:
-    case TYPE_VOLATILE:
-      if (!ref_type)
-        return "void";
-      return ref_type->getName();
-    case TYPE_FUNC:
-      return "<func>";
-    }
-    CHECK(false, "Unknown type: %d", type);
-    return "???";
+  FILE* fp = strcmp(list, "-") ? fopen(list, "r") : stdin;
+  if (!fp)
+    throwError("open failed: %s", list);
+  char* line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  while ((len = getline(&line, &cap, fp)) > 0) {
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = 0;
+    if (len)
+      inputs.push_back(line);
   }
+  free(line);
+  if (fp != stdin)
+    fclose(fp);
+  return inputs;
+}
 
-};
-
-struct Func {
-  uint64_t ret;
-  const char* name;
-  bool external;
-  vector<uint64_t> args;
-  int cu_id;
-  uint64_t offset;
-};
+struct BatchResult {
+  BatchResult()
+    : done(false), failed(false), scan_time(0), dump_time(0) {}
 
-struct DumpCU {
-  vector<Func*> funcs;
-  set<uint64_t> types;
+  bool done;
+  bool failed;
+  // The JSON, or the error with the trace when -t is given.
+  string output;
+  double scan_time;
+  double dump_time;
 };
 
-class DumpDebugScanner : public Scanner {
-public:
-  DumpDebugScanner(Binary* binary)
-    : Scanner(binary),
-      debug_str_(binary->debug_str),
-      debug_str_len_(binary->debug_str_len),
-      cu_cnt_(0),
-      last_func_(NULL) {
+// Runs |fn| with a FILE* whose contents end up in |output|.
+template <class Fn>
+static void writeToString(string* output, Fn fn) {
+  char* buf = NULL;
+  size_t size = 0;
+  FILE* out = open_memstream(&buf, &size);
+  if (!out)
+    throw bad_alloc();
+  try {
+    fn(out);
+  } catch (...) {
+    fclose(out);
+    free(buf);
+    throw;
   }
+  fclose(out);
+  output->assign(buf, size);
+  free(buf);
+}
 
-  void dump() {
-    vector<DumpCU*> cus;
-    DumpCU* cu = NULL;
-    int prev_cu_id = 0;
-    for (size_t i = 0; i < funcs_.size(); i++) {
-      Func* func = funcs_[i];
-      if (!func->name)
-        continue;
-      if (!func->external)
-        continue;
-      offset_ = func->offset;
-
-      if (prev_cu_id != func->cu_id) {
-        prev_cu_id = func->cu_id;
-        cu = new DumpCU;
-        cus.push_back(cu);
-
-#if 1
-        stack<uint64_t> types;
-        for (map<uint64_t, Type*>::const_iterator iter = types_.begin();
-             iter != types_.end();
-             ++iter) {
-          uint64_t type_offset = iter->first;
-          if (isSpecialTypeOffset(type_offset))
-            continue;
-          Type* type = iter->second;
-          if (type->cu_id != func->cu_id)
-            continue;
-          types.push(type_offset);
-        }
-
-        while (!types.empty()) {
-          uint64_t type_offset = types.top();
-          types.pop();
-          if (isSpecialTypeOffset(type_offset))
-            continue;
-          if (cu->types.insert(type_offset).second) {
-            Type* type = getTypeFromOffset(type_offset);
-            if (type->ref) {
-              Type* ref_type = getTypeFromOffset(type->ref);
-              type->ref_type = ref_type;
-              types.push(type->ref);
-            }
-          }
-        }
-#endif
-      }
-
-      cu->funcs.push_back(func);
-
-#if 0
-      stack<uint64_t> types;
-      types.push(func->ret);
-      for (size_t j = 0; j < func->args.size(); j++)
-        types.push(func->args[j]);
-
-      while (!types.empty()) {
-        uint64_t type_offset = types.top();
-        types.pop();
-        if (isSpecialTypeOffset(type_offset))
-          continue;
-        if (cu->types.insert(type_offset).second) {
-          Type* type = getTypeFromOffset(type_offset);
-          if (type->ref) {
-            Type* ref_type = getTypeFromOffset(type->ref);
-            type->ref_type = ref_type;
-            types.push(type->ref);
-          }
-        }
-      }
-#endif
-    }
-
-    puts("[");
-    for (size_t i = 0; i < cus.size(); i++) {
-      if (i)
-        puts(",");
-      puts("{\"type\": {");
-
-      DumpCU* cu = cus[i];
-
-      bool is_first = true;
-      for (set<uint64_t>::const_iterator iter = cu->types.begin();
-           iter != cu->types.end();
-           ++iter) {
-        Type* type = getTypeFromOffset(*iter);
-        if (type->name &&
-            (type->type == Type::TYPE_BASE ||
-             type->type == Type::TYPE_TYPEDEF ||
-             type->type == Type::TYPE_STRUCT)) {
-          if (type->type == Type::TYPE_TYPEDEF &&
-              type->name == type->getName())
-            continue;
-          if (!is_first)
-            puts(",");
-          is_first = false;
-          printf("  \"%s\": %s", type->name, type->getJson().c_str());
-        }
-      }
-
-      puts("");
-      puts(" },");
+// How the dumper writes its output.
+enum DumpMode {
+  // After the whole binary was scanned.
+  DUMP_AFTER_SCAN,
+  // --stream: each CU once it is scanned.
+  DUMP_STREAM,
+  // --pipeline: like DUMP_STREAM, with the stages on their own threads.
+  DUMP_PIPELINED
+};
 
-      puts(" \"func\": {");
+struct DumpOptions {
+  DumpOptions()
+    : mode(DUMP_AFTER_SCAN),
+      log_mode(DumpDebugScanner::LOG_OFF),
+      format(DumpDebugScanner::FORMAT_JSON),
+      dedup_types(false),
+      declarators(false),
+      lazy_types(false) {}
+
+  DumpMode mode;
+  DumpDebugScanner::LogMode log_mode;
+  DumpDebugScanner::Format format;
+  bool dedup_types;
+  bool declarators;
+  bool lazy_types;
+  vector<string> funcs;
+};
 
-      for (size_t i = 0; i < cu->funcs.size(); i++) {
-        Func* func = cu->funcs[i];
-        string args;
-        for (size_t j = 0; j < func->args.size(); j++) {
-          args += stringPrintf(", \"%s\"",
-                               getTypeName(func->args[j]).c_str());
+// Unless the mode is DUMP_AFTER_SCAN, the time to dump is counted as scan
+// time.
+static void dumpOne(const string& input, const DumpOptions& options,
+                    BatchResult* result) {
+  unique_ptr<DumpDebugScanner> dumper;
+  try {
+    double start = now();
+    unique_ptr<Binary> binary(readBinary(input.c_str()));
+    dumper.reset(new DumpDebugScanner(binary.get()));
+    dumper->setLogMode(options.log_mode);
+    dumper->setFormat(options.format);
+    dumper->setDedupTypes(options.dedup_types);
+    dumper->setDeclarators(options.declarators);
+    dumper->setLazyTypes(options.lazy_types);
+    dumper->setFuncs(options.funcs);
+    if (options.mode != DUMP_AFTER_SCAN) {
+      writeToString(&result->output, [&](FILE* out) {
+        if (options.mode == DUMP_PIPELINED) {
+          dumper->dumpPipelined(out);
+          return;
         }
-        printf("  \"%s\": [\"%s\"%s]%s\n",
-               func->name, getTypeName(func->ret).c_str(), args.c_str(),
-               i + 1 == cu->funcs.size() ? "" : ",");
-      }
-
-      puts(" }");
-
-      puts("}");
-
-      delete cu;
+        dumper->setStreamOutput(out);
+        dumper->runBatched(1);
+        dumper->dump(out);
+      });
+      result->scan_time = now() - start;
+      return;
     }
-    puts("]");
-  }
-
-private:
-  virtual void onCU(CU* cu, uint64_t offset) {
-    offset_ = offset;
-    last_func_ = NULL;
-    report("CU: %d len=%x version=%x ptrsize=%x",
-           cu_cnt_, cu->length, cu->version, cu->ptrsize);
-    cu_cnt_++;
-    cu_offset_ = offset;
+    dumper->runBatched(1);
+    result->scan_time = now() - start;
+    start = now();
+    writeToString(&result->output, [&](FILE* out) { dumper->dump(out); });
+    result->dump_time = now() - start;
+  } catch (const CrefError& e) {
+    result->failed = true;
+    writeToString(&result->output, [&](FILE* out) {
+      if (dumper)
+        dumper->dumpTrace(out);
+      fprintf(out, "%s\n", e.what());
+    });
   }
+}
 
-  virtual bool onAbbrev(uint16_t tag, uint64_t /*number*/, uint64_t offset) {
-    if (tag != DW_TAG_formal_parameter &&
-        tag != DW_TAG_unspecified_parameters) {
-      last_func_ = NULL;
-    }
-    prev_tag_ = tag_;
-    tag_ = tag;
-    if (tag == DW_TAG_base_type ||
-        tag == DW_TAG_typedef ||
-        tag == DW_TAG_structure_type ||
-        tag == DW_TAG_union_type ||
-        tag == DW_TAG_enumeration_type ||
-        tag == DW_TAG_pointer_type ||
-        tag == DW_TAG_array_type ||
-        tag == DW_TAG_const_type ||
-        tag == DW_TAG_volatile_type ||
-        tag == DW_TAG_subroutine_type ||
-        tag == DW_TAG_subprogram ||
-        tag == DW_TAG_formal_parameter ||
-        tag == DW_TAG_unspecified_parameters) {
-      offset_ = offset;
-      values_.clear();
-      return true;
-    }
-    return false;
+// The output files of |inputs| in |out_dir|, <basename>.json (.ndjson,
+// .cref). Inputs with a basename taken by an earlier one get
+// <basename>.<n>.json with the first <n> from 1 which is free.
+static vector<string> getOutputPaths(const vector<string>& inputs,
+                                     const char* out_dir,
+                                     DumpDebugScanner::Format format) {
+  static const char* kSuffixes[] = { ".json", ".ndjson", ".cref" };
+  vector<string> paths;
+  unordered_set<string> used;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const char* base = strrchr(inputs[i].c_str(), '/');
+    base = base ? base + 1 : inputs[i].c_str();
+    string path = string(out_dir) + '/' + base;
+    string unique = path;
+    for (int n = 1; used.count(unique); n++)
+      unique = stringPrintf("%s.%d", path.c_str(), n);
+    used.insert(unique);
+    paths.push_back(unique + kSuffixes[format]);
   }
+  return paths;
+}
 
-  virtual void onAbbrevDone() {
-    switch (tag_) {
-    case DW_TAG_base_type:
-      handleBaseType();
-      break;
-    case DW_TAG_typedef:
-      handleTypedef();
-      break;
-    case DW_TAG_structure_type:
-    case DW_TAG_union_type:
-    case DW_TAG_enumeration_type:
-      handleStruct();
-      break;
-    case DW_TAG_pointer_type:
-      handleQualifiler(Type::TYPE_POINTER);
-      break;
-    case DW_TAG_array_type:
-      handleQualifiler(Type::TYPE_ARRAY);
-      break;
-    case DW_TAG_const_type:
-      handleQualifiler(Type::TYPE_CONST);
-      break;
-    case DW_TAG_volatile_type:
-      handleQualifiler(Type::TYPE_VOLATILE);
-      break;
-    case DW_TAG_subroutine_type:
-      handleSubroutine();
-      break;
-    case DW_TAG_subprogram:
-      handleFunction();
-      break;
-    case DW_TAG_formal_parameter:
-      if (prev_tag_ == DW_TAG_subprogram ||
-          prev_tag_ == DW_TAG_formal_parameter) {
-        handleParameter();
-      }
-      break;
-    case DW_TAG_unspecified_parameters:
-      if (prev_tag_ == DW_TAG_subprogram ||
-          prev_tag_ == DW_TAG_formal_parameter) {
-        handleUnspecifiedParameters();
-      }
-      break;
+// Dumps |inputs| on num_threads threads, each binary on one thread. The
+// results go to the files getOutputPaths() names if |out_dir| is given,
+// or else to stdout as one JSON object keyed by the input paths. Either
+// way they are written in input order, with the time each took on
+// stderr.
+static int runBatch(const vector<string>& inputs, int num_threads,
+                    const char* out_dir, const DumpOptions& options) {
+  vector<string> out_paths;
+  if (out_dir)
+    out_paths = getOutputPaths(inputs, out_dir, options.format);
+  vector<BatchResult> results(inputs.size());
+  mutex mu;
+  condition_variable cond;
+
+  WorkStealingPool pool(max(num_threads, 1), inputs.size(), [&](size_t i) {
+    BatchResult result;
+    dumpOne(inputs[i], options, &result);
+    result.done = true;
+    lock_guard<mutex> lock(mu);
+    results[i] = move(result);
+    cond.notify_all();
+  });
+
+  int num_failed = 0;
+  if (!out_dir)
+    puts("{");
+  bool is_first = true;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    BatchResult result;
+    {
+      unique_lock<mutex> lock(mu);
+      while (!results[i].done)
+        cond.wait(lock);
+      result = move(results[i]);
     }
-  }
 
-  virtual void onAttr(uint16_t name, uint8_t /*form*/, uint64_t value,
-                      uint64_t /*offset*/) {
-    if (!values_.insert(make_pair(name, value)).second) {
-      fprintf(stderr, "Duplicated name: %d\n", (int)name);
-      exit(1);
+    if (result.failed) {
+      num_failed++;
+      fprintf(stderr, "%s: failed\n%s", inputs[i].c_str(),
+              result.output.c_str());
+      continue;
     }
-  }
-
-  void addType(Type* type) {
-    type->cu_id = cu_cnt_;
-    type->offset = offset_;
-    if (!types_.insert(make_pair(offset_, type)).second) {
-      fprintf(stderr, "Duplicated offset: %"PRIx64"\n", offset_);
-      exit(1);
+    fprintf(stderr, "%s: scan %.3fs dump %.3fs\n",
+            inputs[i].c_str(), result.scan_time, result.dump_time);
+
+    if (out_dir) {
+      const string& path = out_paths[i];
+      FILE* fp = fopen(path.c_str(), "w");
+      bool written =
+        fp && fwrite(result.output.data(), 1, result.output.size(), fp) ==
+        result.output.size();
+      if (fp && fclose(fp))
+        written = false;
+      if (!written) {
+        fprintf(stderr, "%s: cannot write\n", path.c_str());
+        num_failed++;
+      } else {
+        fprintf(stderr, "%s: wrote %s\n", inputs[i].c_str(), path.c_str());
+      }
+    } else {
+      JsonWriter writer(stdout);
+      if (!is_first)
+        writer.raw(",\n");
+      is_first = false;
+      writer.quoted(inputs[i]);
+      writer.raw(":\n");
+      writer.raw(result.output);
+      writer.flush();
     }
   }
-
-  void handleBaseType() {
-    uint64_t size = getValue(DW_AT_byte_size);
-    //uint64_t encoding = getValue(DW_AT_encoding);
-    const char* name = getStrOrNull(DW_AT_name);
-    if (!name)
-      name = "???";
-    report("basetype: %s", name);
-    addType(new Type(Type::TYPE_BASE, size, name));
-  }
-
-  void handleTypedef() {
-    uint64_t type = getType();
-    const char* name = getStr(DW_AT_name);
-    report("typedef: %s", name);
-    addType(new Type(Type::TYPE_TYPEDEF, name, type));
-  }
-
-  void handleStruct() {
-    uint64_t size = getValueOrZero(DW_AT_byte_size);
-    const char* name = getStrOrNull(DW_AT_name);
-    report("struct: %s", name);
-    addType(new Type(Type::TYPE_STRUCT, size, name));
-  }
-
-  void handleQualifiler(int qual) {
-    uint64_t type = getType();
-    const char* name = getStrOrNull(DW_AT_name);
-    report("qualifier: %s type=%"PRIx64, name, type);
-    addType(new Type(qual, name, type));
-  }
-
-  void handleSubroutine() {
-    last_func_ = NULL;
-    addType(new Type(Type::TYPE_FUNC));
-  }
-
-  void handleFunction() {
-    uint64_t ret = getType();
-    const char* name = getStrOrNull(DW_AT_name);
-    uint64_t external = getValueOrZero(DW_AT_external);
-    if (!name)
-      return;
-    report("function: %s ret=%"PRIx64" %"PRIx64, name, ret);
-    last_func_ = new Func();
-    last_func_->ret = ret;
-    last_func_->name = name;
-    last_func_->external = external;
-    last_func_->cu_id = cu_cnt_;
-    last_func_->offset = offset_;
-    funcs_.push_back(last_func_);
-  }
-
-  void handleParameter() {
-    if (!last_func_)
-      return;
-    uint64_t type = getType();
-    last_func_->args.push_back(type);
-  }
-
-  void handleUnspecifiedParameters() {
-    if (!last_func_)
-      return;
-    last_func_->args.push_back(VAARG_OFFSET);
-  }
-
-  const char* getStr(int name) const {
-    uint64_t v = getValue(name);
-    if (v >= debug_str_len_)
-      return (const char*)v;
-    else
-      return debug_str_ + v;
-  }
-
-  const char* getStrOrNull(int name) const {
-    uint64_t v = getValueOrZero(name);
-    if (!v)
-      return NULL;
-    if (v >= debug_str_len_)
-      return (const char*)v;
-    else
-      return debug_str_ + v;
-  }
-
-  uint64_t getType() const {
-    uint64_t v = getValueOrZero(DW_AT_type);
-    if (!v)
-      return v;
-    return v + cu_offset_;
-  }
-
-  Type* getTypeFromOffset(uint64_t offset) const {
-    map<uint64_t, Type*>::const_iterator found = types_.find(offset);
-    CHECK(found != types_.end(), "Type %"PRIx64" not found", offset);
-    return found->second;
-  }
-
-  uint64_t getValue(int name) const {
-    map<int, uint64_t>::const_iterator found = values_.find(name);
-    CHECK(found != values_.end(), "Name not found: %d", name);
-    return found->second;
-  }
-
-  uint64_t getValueOrZero(int name) const {
-    map<int, uint64_t>::const_iterator found = values_.find(name);
-    return found != values_.end() ? found->second : 0;
+  if (!out_dir) {
+    puts("}");
+    if (fflush(stdout) != 0 || ferror(stdout))
+      throwError("write failed: %s", strerror(errno));
   }
 
-  string getTypeName(uint64_t offset) const {
-    if (!offset)
-      return "void";
-    if (offset == VAARG_OFFSET)
-      return "...";
-    return getTypeFromOffset(offset)->getName();
-  }
-
-  const char* debug_str_;
-  size_t debug_str_len_;
-
-  int cu_cnt_;
-  uint64_t cu_offset_;
-
-  map<uint64_t, Type*> types_;
-  vector<Func*> funcs_;
-  Func* last_func_;
-
-  uint16_t tag_;
-  uint16_t prev_tag_;
-  map<int, uint64_t> values_;
-};
-
-static const int HEADER_SIZE = 8;
+  if (num_failed)
+    fprintf(stderr, "%d of %zu inputs failed\n", num_failed, inputs.size());
+  return num_failed ? 1 : 0;
+}
 
 int main(int argc, char* argv[]) {
   const char* argv0 = argv[0];
-  for (int i = 1; i < argc; i++) {
-    if (argv[i][0] != '-') {
-      continue;
+  int num_threads = 1;
+  const char* batch = NULL;
+  const char* out_dir = NULL;
+  DumpOptions options;
+  while (argc > 1 && argv[1][0] == '-') {
+    if (!strncmp(argv[1], "-j", 2)) {
+      num_threads = atoi(argv[1] + 2);
+    } else if (!strcmp(argv[1], "-v")) {
+      options.log_mode = DumpDebugScanner::LOG_VERBOSE;
+    } else if (!strcmp(argv[1], "-t")) {
+      options.log_mode = DumpDebugScanner::LOG_TRACE;
+    } else if (!strcmp(argv[1], "--stream")) {
+      options.mode = DUMP_STREAM;
+    } else if (!strcmp(argv[1], "--pipeline")) {
+      options.mode = DUMP_PIPELINED;
+    } else if (!strcmp(argv[1], "--ndjson")) {
+      options.format = DumpDebugScanner::FORMAT_NDJSON;
+    } else if (!strcmp(argv[1], "--binary")) {
+      options.format = DumpDebugScanner::FORMAT_BINARY;
+    } else if (!strcmp(argv[1], "--dedup")) {
+      options.dedup_types = true;
+    } else if (!strcmp(argv[1], "--declarators")) {
+      options.declarators = true;
+    } else if (!strcmp(argv[1], "--lazy")) {
+      options.lazy_types = true;
+    } else if (!strcmp(argv[1], "--func") && argc > 2) {
+      options.funcs.push_back(argv[2]);
+      argc--;
+      argv++;
+    } else if (!strcmp(argv[1], "--batch") && argc > 2) {
+      batch = argv[2];
+      argc--;
+      argv++;
+    } else if (!strcmp(argv[1], "-o") && argc > 2) {
+      out_dir = argv[2];
+      argc--;
+      argv++;
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[1]);
     }
-    fprintf(stderr, "Unknown option: %s\n", argv[i]);
     argc--;
     argv++;
   }
 
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s binary\n", argv0);
+  if (argc < 2 && !batch) {
+    fprintf(stderr,
+            "Usage: %s [-j<threads>] [-v|-t] [--stream|--pipeline] "
+            "[--ndjson|--binary] [--dedup] [--declarators]\n"
+            "          [--lazy] [--func name]... binary\n"
+            "       %s [-j<threads>] [-v|-t] [--stream|--pipeline] "
+            "[--ndjson|--binary] [--dedup] [--declarators]\n"
+            "          [--lazy] [--func name]... [-o dir] --batch list\n"
+            " -v: report every CU, type and function\n"
+            " -t: keep the last reports and print them on errors and exit\n"
+            " --stream: write each CU once it is scanned instead of keeping\n"
+            "           them all in memory\n"
+            " --pipeline: like --stream, but decode, resolve and write on\n"
+            "             three threads per binary\n"
+            " --ndjson: write one JSON object per CU and line instead of\n"
+            "           one array. Needs -o with --batch\n"
+            " --binary: write a result file for ResultReader (see\n"
+            "           result_file.h) instead of JSON. Needs -o with --batch\n"
+            " --dedup: list each distinct type only in the first CU which\n"
+            "          has it\n"
+            " --declarators: write types as C declarators, like\n"
+            "                \"int (*)(const char*, size_t)\" and\n"
+            "                \"char[108]\"\n"
+            " --lazy: decode and list only the types the dumped functions\n"
+            "         refer to\n"
+            " --func: dump only the CUs of these external functions, and\n"
+            "         only them. Best with --lazy\n"
+            " --batch: dump the binaries in the directory |list|, or listed\n"
+            "          one per line in the file |list| (- for stdin),\n"
+            "          <threads> at once\n"
+            " -o: write <dir>/<basename>.json (.ndjson, .cref) for each\n"
+            "     binary instead of one JSON object keyed by path to stdout.\n"
+            "     Repeated basenames get <basename>.<n>.json\n",
+            argv0, argv0);
     exit(1);
   }
 
-  auto_ptr<Binary> binary(readBinary(argv[1]));
+  if (batch) {
+    if (options.format != DumpDebugScanner::FORMAT_JSON && !out_dir) {
+      fprintf(stderr, "%s with --batch needs -o\n",
+              options.format == DumpDebugScanner::FORMAT_NDJSON ?
+              "--ndjson" : "--binary");
+      exit(1);
+    }
+    try {
+      return runBatch(readInputs(batch), num_threads, out_dir, options);
+    } catch (const CrefError& e) {
+      fprintf(stderr, "%s\n", e.what());
+      exit(1);
+    }
+  }
 
-  DumpDebugScanner dumper(binary.get());
-  dumper.run();
-  dumper.dump();
+  unique_ptr<Binary> binary;
+  unique_ptr<DumpDebugScanner> dumper;
+  try {
+    binary.reset(readBinary(argv[1]));
+    dumper.reset(new DumpDebugScanner(binary.get()));
+    dumper->setLogMode(options.log_mode);
+    dumper->setFormat(options.format);
+    dumper->setDedupTypes(options.dedup_types);
+    dumper->setDeclarators(options.declarators);
+    dumper->setLazyTypes(options.lazy_types);
+    dumper->setFuncs(options.funcs);
+    if (options.mode == DUMP_PIPELINED) {
+      dumper->dumpPipelined(stdout);
+    } else {
+      if (options.mode == DUMP_STREAM)
+        dumper->setStreamOutput(stdout);
+      dumper->runBatched(num_threads);
+      dumper->dump(stdout);
+    }
+  } catch (const CrefError& e) {
+    if (dumper)
+      dumper->dumpTrace(stderr);
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+  dumper->dumpTrace(stderr);
 }
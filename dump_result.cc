@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "json_writer.h"
+#include "result_file.h"
+#include "util.h"
+
+using namespace std;
+
+// Prints a result file written by dump_debug_info --binary the way
+// --ndjson would have, as an example of ResultReader.
+static void printResult(const ResultReader& reader, JsonWriter* out) {
+  static const char* kKinds[] = { "base", "typedef", "struct" };
+  for (uint32_t i = 0; i < reader.numCUs(); i++) {
+    const ResultCU& cu = reader.cu(i);
+    out->raw("{\"type\": {");
+    for (uint32_t j = 0; j < cu.num_types; j++) {
+      const ResultType& type = reader.cuType(cu, j);
+      if (j)
+        out->raw(", ");
+      out->quoted(reader.str(type.name));
+      out->raw(": [\"");
+      out->raw(kKinds[min(type.kind, (uint32_t)ResultType::STRUCT)]);
+      out->raw("\", ");
+      if (type.kind == ResultType::TYPEDEF)
+        out->quoted(reader.str(type.target));
+      else
+        out->integer(type.size);
+      out->raw(']');
+    }
+    out->raw("}, \"func\": {");
+    for (uint32_t j = 0; j < cu.num_funcs; j++) {
+      const ResultFunc& func = reader.func(cu.funcs_begin + j);
+      if (j)
+        out->raw(", ");
+      out->quoted(reader.str(func.name));
+      out->raw(": [");
+      for (uint32_t k = 0; k < func.num_types; k++) {
+        if (k)
+          out->raw(", ");
+        out->quoted(reader.funcType(func, k));
+      }
+      out->raw(']');
+    }
+    out->raw("}}\n");
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s result.cref\n", argv[0]);
+    exit(1);
+  }
+
+  try {
+    ResultReader reader(argv[1]);
+    JsonWriter writer(stdout);
+    printResult(reader, &writer);
+    writer.flush();
+  } catch (const CrefError& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+}
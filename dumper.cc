@@ -0,0 +1,1279 @@
+#include "dumper.h"
+
+#include <dwarf.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <memory>
+#include <stack>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "binary.h"
+#include "json_writer.h"
+#include "result_file.h"
+#include "spsc_queue.h"
+#include "util.h"
+
+using namespace std;
+
+// DumpDebugScanner only implements the callbacks of runBatched().
+template void StaticScanner<DumpDebugScanner>::runBatched(int num_threads);
+
+// Throws a CrefError about the DIE at |offset|.
+[[noreturn]] static void dieError(uint64_t offset, const char* fmt, ...)
+  __attribute__((format(printf, 2, 3)));
+
+static void dieError(uint64_t offset, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  char* str;
+  int r = vasprintf(&str, fmt, ap);
+  va_end(ap);
+  if (r < 0)
+    throw bad_alloc();
+  string msg(str);
+  free(str);
+  throwError("%" PRIx64 ": %s", offset, msg.c_str());
+}
+
+#define CHECK(c, offset, ...) if (!(c)) dieError(offset, __VA_ARGS__)
+
+static const uint64_t VAARG_OFFSET = (uint64_t)-1;
+
+static const size_t kTraceSize = 1 << 16;
+
+// Type::canonical of a type whose ID is being made.
+static const uint32_t CANONICALIZING = 0xfffffffe;
+
+// In the parameter lists of TypeTable.
+static const uint32_t VAARG_ID = 0xfffffffe;
+// In type_args_ and the bound lists of TypeTable, for arrays whose bound is
+// not a constant.
+static const uint32_t UNKNOWN_BOUND = 0xffffffff;
+// In members_, for members whose location is not a constant.
+static const uint64_t UNKNOWN_LOCATION = (uint64_t)-1;
+
+static bool isSpecialTypeOffset(uint64_t offset) {
+  return offset == 0 || offset == VAARG_OFFSET;
+}
+
+// Members of unions have no location. DWARF 2 gives it as an expression
+// with a single DW_OP_plus_uconst.
+static uint64_t getMemberLocation(const AttrValue* attr) {
+  if (!attr)
+    return 0;
+  if (attr->kind == AttrValue::CONSTANT)
+    return attr->value;
+  if (attr->kind != AttrValue::BLOCK || attr->value < 2 ||
+      (uint8_t)attr->data[0] != DW_OP_plus_uconst) {
+    return UNKNOWN_LOCATION;
+  }
+  uint64_t location = 0;
+  for (uint64_t i = 1, shift = 0; i < attr->value && shift < 64; i++) {
+    uint8_t byte = attr->data[i];
+    location |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return i + 1 == attr->value ? location : UNKNOWN_LOCATION;
+    shift += 7;
+  }
+  return UNKNOWN_LOCATION;
+}
+
+int Type::getSize(const vector<Type>& types) const {
+  if (size)
+    return size;
+  if (type == TYPE_TYPEDEF || type == TYPE_CONST || type == TYPE_VOLATILE)
+    return types[ref_type].getSize(types);
+  return 0;
+}
+
+struct DumpCU {
+  vector<uint32_t> funcs;
+  // Indices of types, which are in .debug_info order.
+  vector<uint32_t> types;
+};
+
+// A DumpCU with all names made.
+struct RenderedCU {
+  struct Type {
+    const char* name;
+    // TYPE_BASE, TYPE_TYPEDEF or one for which Type::isStruct().
+    int type;
+    int size;
+    // What a typedef names.
+    string_view target;
+  };
+
+  struct Func {
+    const char* name;
+    // The return type, then the parameters.
+    vector<string_view> types;
+  };
+
+  vector<Type> types;
+  vector<Func> funcs;
+};
+
+// Where the rendered CUs go, in the format asked for.
+class DumpOutput {
+public:
+  DumpOutput(FILE* out, DumpDebugScanner::Format format);
+
+  void add(const RenderedCU& cu);
+  // Ends the JSON array, or writes the whole FORMAT_BINARY file.
+  void finish();
+
+private:
+  void writeJson(const RenderedCU& cu);
+
+  DumpDebugScanner::Format format_;
+  JsonWriter json_;
+  ResultWriter result_;
+  size_t num_cus_;
+};
+
+DumpDebugScanner::DumpDebugScanner(Binary* binary)
+  : StaticScanner<DumpDebugScanner>(binary),
+    offset_(0),
+    depth_(0),
+    cu_cnt_(0),
+    last_func_(NO_FUNC),
+    last_type_(Type::NONE),
+    last_type_depth_(0),
+    format_(FORMAT_JSON),
+    dedup_types_(false),
+    declarators_(false),
+    lazy_types_(false),
+    stream_out_(NULL),
+    emit_queue_(NULL),
+    num_streamed_(0),
+    cu_begin_(0),
+    cu_end_(0),
+    loading_foreign_(false),
+    present_(0),
+    log_mode_(LOG_OFF),
+    trace_next_(0) {
+}
+
+DumpDebugScanner::~DumpDebugScanner() {
+}
+
+void DumpDebugScanner::setLazyTypes(bool lazy) {
+  lazy_types_ = lazy && !binary_->is_zipped;
+}
+
+void DumpDebugScanner::setFuncs(const vector<string>& names) {
+  wanted_funcs_.clear();
+  wanted_funcs_.insert(names.begin(), names.end());
+}
+
+void DumpDebugScanner::dump(FILE* out) {
+  if (stream_out_) {
+    flushCU();
+    stream_output_->finish();
+    return;
+  }
+
+  vector<unique_ptr<DumpCU> > cus;
+  collectCUs(&cus);
+  DumpOutput output(out, format_);
+  RenderedCU rendered;
+  for (size_t i = 0; i < cus.size(); i++) {
+    rendered.types.clear();
+    rendered.funcs.clear();
+    renderCU(*cus[i], &rendered);
+    output.add(rendered);
+  }
+  output.finish();
+}
+
+// The writer thread has |output| to itself until it is joined.
+void DumpDebugScanner::dumpPipelined(FILE* out) {
+  SPSCQueue<unique_ptr<RenderedCU> > queue(kEmitDepth);
+  DumpOutput output(out, format_);
+  // After a write fails, the writer drops the rest, so that the queue
+  // never blocks, and the error is thrown here once it is joined.
+  exception_ptr write_error;
+  thread writer([&queue, &output, &write_error]() {
+    unique_ptr<RenderedCU> cu;
+    while (queue.pop(&cu)) {
+      if (write_error)
+        continue;
+      try {
+        output.add(*cu);
+      } catch (...) {
+        write_error = current_exception();
+      }
+    }
+  });
+
+  stream_out_ = out;
+  emit_queue_ = &queue;
+  try {
+    runPipelined();
+    flushCU();
+  } catch (...) {
+    queue.close();
+    writer.join();
+    emit_queue_ = NULL;
+    throw;
+  }
+  queue.close();
+  writer.join();
+  emit_queue_ = NULL;
+  if (write_error)
+    rethrow_exception(write_error);
+  output.finish();
+}
+
+// Writes the CU being scanned when streaming and forgets its types and
+// functions.
+void DumpDebugScanner::flushCU() {
+  if (!stream_output_ && !emit_queue_)
+    stream_output_.reset(new DumpOutput(stream_out_, format_));
+  if (!cu_cnt_)
+    return;
+  vector<unique_ptr<DumpCU> > cus;
+  collectCUs(&cus);
+  for (size_t i = 0; i < cus.size(); i++) {
+    unique_ptr<RenderedCU> rendered(new RenderedCU);
+    renderCU(*cus[i], rendered.get());
+    if (emit_queue_)
+      emit_queue_->push(move(rendered));
+    else
+      stream_output_->add(*rendered);
+    num_streamed_++;
+  }
+
+  type_arena_.clear();
+  foreign_types_.clear();
+  funcs_.clear();
+  func_args_.clear();
+  type_args_.clear();
+  members_.clear();
+  vector<uint32_t>().swap(cu_types_[cu_cnt_]);
+}
+
+// Groups the external functions in funcs_ by CU, each with the types
+// reachable from its CU.
+void DumpDebugScanner::collectCUs(vector<unique_ptr<DumpCU> >* cus) {
+  DumpCU* cu = NULL;
+  int prev_cu_id = 0;
+  // The last CU each type was collected for.
+  vector<int> type_cu(type_arena_.size(), 0);
+  for (size_t i = 0; i < funcs_.size(); i++) {
+    const Func* func = &funcs_[i];
+    if (!func->name)
+      continue;
+    if (!func->external)
+      continue;
+    if (!wanted_funcs_.empty() && !wanted_funcs_.count(func->name))
+      continue;
+    offset_ = func->offset;
+
+    if (prev_cu_id != func->cu_id) {
+      prev_cu_id = func->cu_id;
+      cu = new DumpCU;
+      cus->push_back(unique_ptr<DumpCU>(cu));
+    }
+
+    cu->funcs.push_back(i);
+
+#if 1
+    // All types of the CU are listed, except in lazy mode, which only
+    // decodes the types the dumped functions reach.
+    stack<uint32_t> types;
+    if (lazy_types_) {
+      if (!isSpecialTypeOffset(func->ret))
+        types.push(getTypeIndex(func->ret));
+      for (size_t j = 0; j < func->num_args; j++) {
+        uint64_t arg = func_args_[func->args_begin + j];
+        if (!isSpecialTypeOffset(arg))
+          types.push(getTypeIndex(arg));
+      }
+    } else if (cu->funcs.size() == 1) {
+      const vector<uint32_t>& cu_types = cu_types_[func->cu_id];
+      for (size_t j = 0; j < cu_types.size(); j++)
+        types.push(cu_types[j]);
+    }
+    type_cu.resize(type_arena_.size(), 0);
+
+    while (!types.empty()) {
+      uint32_t index = types.top();
+      types.pop();
+      if (type_cu[index] == func->cu_id)
+        continue;
+      type_cu[index] = func->cu_id;
+      cu->types.push_back(index);
+      if (type_arena_[index].type == Type::TYPE_FUNC) {
+        for (uint32_t k = 0; k < type_arena_[index].num_args; k++) {
+          uint64_t arg = type_args_[type_arena_[index].args_begin + k];
+          if (!isSpecialTypeOffset(arg))
+            types.push(getTypeIndex(arg));
+        }
+        type_cu.resize(type_arena_.size(), 0);
+      }
+      uint64_t ref = type_arena_[index].ref;
+      if (isSpecialTypeOffset(ref))
+        continue;
+      // Resolved once, even when several CUs reach the type. This may
+      // add a type from another CU when streaming.
+      if (type_arena_[index].ref_type == Type::NONE) {
+        uint32_t ref_type = getTypeIndex(ref);
+        type_arena_[index].ref_type = ref_type;
+        type_cu.resize(type_arena_.size(), 0);
+      }
+      types.push(type_arena_[index].ref_type);
+    }
+#endif
+
+#if 0
+    stack<uint64_t> types;
+    types.push(func->ret);
+    for (size_t j = 0; j < func->num_args; j++)
+      types.push(func_args_[func->args_begin + j]);
+
+    while (!types.empty()) {
+      uint64_t type_offset = types.top();
+      types.pop();
+      if (isSpecialTypeOffset(type_offset))
+        continue;
+      uint32_t index = getTypeIndex(type_offset);
+      if (type_cu[index] != func->cu_id) {
+        type_cu[index] = func->cu_id;
+        cu->types.push_back(index);
+        Type* type = &type_arena_[index];
+        if (type->ref) {
+          type->ref_type = getTypeIndex(type->ref);
+          types.push(type->ref);
+        }
+      }
+    }
+#endif
+  }
+
+  // Indices are in .debug_info order unless types were read from other
+  // CUs.
+  const vector<Type>& arena = type_arena_;
+  for (size_t i = 0; i < cus->size(); i++) {
+    sort((*cus)[i]->types.begin(), (*cus)[i]->types.end(),
+         [&arena](uint32_t a, uint32_t b) {
+           return arena[a].offset < arena[b].offset;
+         });
+  }
+}
+
+// Everything DumpDebugScanner collects and resolves is gathered here
+// first, so that pipelined writers never look at the scanner.
+void DumpDebugScanner::renderCU(const DumpCU& cu, RenderedCU* out) {
+  for (size_t i = 0; i < cu.types.size(); i++) {
+    if (!type_arena_[cu.types[i]].name)
+      continue;
+    uint32_t id = getCanonicalType(cu.types[i]);
+    uint32_t written = id;
+    if (dedup_types_ && Type::isStruct(type_arena_[cu.types[i]].type))
+      written = getStructLayout(cu.types[i]);
+    if (dedup_types_ && written < written_types_.size() &&
+        written_types_[written]) {
+      continue;
+    }
+    const Type* type = &type_arena_[cu.types[i]];
+    RenderedCU::Type rendered;
+    rendered.name = type->name;
+    rendered.type = type->type;
+    rendered.size = type->size;
+    switch (type->type) {
+    case Type::TYPE_BASE:
+      CHECK(type->size, type->offset, "Uknkown size for base");
+      break;
+    case Type::TYPE_TYPEDEF:
+      if (declarators_) {
+        uint32_t ref = canonical_types_.get(id).ref;
+        // "typedef struct foo foo" would list foo twice.
+        if (ref != TypeTable::NONE &&
+            Type::isStruct(canonical_types_.get(ref).type) &&
+            canonical_types_.get(ref).name &&
+            !strcmp(canonical_types_.get(ref).name, type->name)) {
+          continue;
+        }
+        rendered.target = (ref != TypeTable::NONE ?
+                           getCanonicalName(ref) : "void");
+      } else {
+        rendered.target = getCanonicalName(id);
+      }
+      if (rendered.target == type->name)
+        continue;
+      break;
+    case Type::TYPE_STRUCT:
+    case Type::TYPE_UNION:
+    case Type::TYPE_ENUM:
+      break;
+    default:
+      continue;
+    }
+    out->types.push_back(move(rendered));
+    if (dedup_types_) {
+      if (written >= written_types_.size())
+        written_types_.resize(canonical_types_.size());
+      written_types_[written] = true;
+    }
+  }
+
+  for (size_t i = 0; i < cu.funcs.size(); i++) {
+    const Func* func = &funcs_[cu.funcs[i]];
+    out->funcs.push_back(RenderedCU::Func());
+    RenderedCU::Func* rendered = &out->funcs.back();
+    rendered->name = func->name;
+    rendered->types.push_back(getTypeName(func->ret));
+    for (size_t j = 0; j < func->num_args; j++)
+      rendered->types.push_back(
+          getTypeName(func_args_[func->args_begin + j]));
+  }
+}
+
+// The whitespace of each format. FORMAT_NDJSON puts each CU on a line.
+struct CULayout {
+  const char* begin;
+  const char* indent;
+  const char* separator;
+  const char* func_begin;
+  const char* last_func;
+  const char* end;
+};
+
+static const CULayout kLayouts[] = {
+  // FORMAT_JSON
+  { "{\"type\": {\n", "  ", ",\n", "\n },\n \"func\": {\n", "\n", " }\n}\n" },
+  // FORMAT_NDJSON
+  { "{\"type\": {", "", ", ", "}, \"func\": {", "", "}}\n" },
+};
+
+DumpOutput::DumpOutput(FILE* out, DumpDebugScanner::Format format)
+  : format_(format),
+    json_(out),
+    result_(out),
+    num_cus_(0) {
+}
+
+void DumpOutput::add(const RenderedCU& cu) {
+  if (format_ == DumpDebugScanner::FORMAT_BINARY) {
+    result_.beginCU();
+    for (size_t i = 0; i < cu.types.size(); i++) {
+      const RenderedCU::Type& type = cu.types[i];
+      uint32_t kind = (type.type == Type::TYPE_BASE ? ResultType::BASE :
+                       type.type == Type::TYPE_TYPEDEF ? ResultType::TYPEDEF :
+                       ResultType::STRUCT);
+      result_.addType(type.name, kind, type.size, type.target);
+    }
+    for (size_t i = 0; i < cu.funcs.size(); i++) {
+      const RenderedCU::Func& func = cu.funcs[i];
+      result_.addFunc(func.name, func.types.data(), func.types.size());
+    }
+  } else {
+    writeJson(cu);
+  }
+  num_cus_++;
+}
+
+void DumpOutput::finish() {
+  if (format_ == DumpDebugScanner::FORMAT_BINARY) {
+    result_.finish();
+    return;
+  }
+  if (format_ == DumpDebugScanner::FORMAT_JSON)
+    json_.raw(num_cus_ ? "]\n" : "[\n]\n");
+  json_.flush();
+}
+
+// FORMAT_JSON puts the CUs in an array.
+void DumpOutput::writeJson(const RenderedCU& cu) {
+  const CULayout& layout = kLayouts[format_];
+  JsonWriter* out = &json_;
+  if (format_ == DumpDebugScanner::FORMAT_JSON)
+    out->raw(num_cus_ ? ",\n" : "[\n");
+  out->raw(layout.begin);
+
+  for (size_t i = 0; i < cu.types.size(); i++) {
+    const RenderedCU::Type& type = cu.types[i];
+    if (i)
+      out->raw(layout.separator);
+    out->raw(layout.indent);
+    out->quoted(type.name);
+    switch (type.type) {
+    case Type::TYPE_BASE:
+      out->raw(": [\"base\", ");
+      out->integer(type.size);
+      break;
+    case Type::TYPE_TYPEDEF:
+      out->raw(": [\"typedef\", ");
+      out->quoted(type.target);
+      break;
+    default:
+      out->raw(": [\"struct\", ");
+      out->integer(type.size);
+    }
+    out->raw(']');
+  }
+
+  out->raw(layout.func_begin);
+
+  for (size_t i = 0; i < cu.funcs.size(); i++) {
+    const RenderedCU::Func& func = cu.funcs[i];
+    out->raw(layout.indent);
+    out->quoted(func.name);
+    out->raw(": [");
+    for (size_t j = 0; j < func.types.size(); j++) {
+      if (j)
+        out->raw(", ");
+      out->quoted(func.types[j]);
+    }
+    out->raw(']');
+    out->raw(i + 1 == cu.funcs.size() ? layout.last_func : layout.separator);
+  }
+
+  out->raw(layout.end);
+}
+
+static const char* logStr(uint64_t arg) {
+  return arg ? (const char*)arg : "(null)";
+}
+
+string DumpDebugScanner::formatEvent(int event, const uint64_t* args) {
+  switch (event) {
+  case EVENT_CU:
+    return stringPrintf("CU: %d len=%x version=%x ptrsize=%x",
+                        (int)args[0], (int)args[1], (int)args[2],
+                        (int)args[3]);
+  case EVENT_BASE_TYPE:
+    return stringPrintf("basetype: %s", logStr(args[0]));
+  case EVENT_TYPEDEF:
+    return stringPrintf("typedef: %s", logStr(args[0]));
+  case EVENT_STRUCT:
+    return stringPrintf("struct: %s", logStr(args[0]));
+  case EVENT_QUALIFIER:
+    return stringPrintf("qualifier: %s type=%" PRIx64,
+                        logStr(args[0]), args[1]);
+  case EVENT_FUNCTION:
+    return stringPrintf("function: %s ret=%" PRIx64,
+                        logStr(args[0]), args[1]);
+  }
+  return stringPrintf("unknown event: %d", event);
+}
+
+void DumpDebugScanner::dumpTrace(FILE* out) const {
+  if (log_mode_ != LOG_TRACE)
+    return;
+  size_t begin = trace_next_ > kTraceSize ? trace_next_ - kTraceSize : 0;
+  for (size_t i = begin; i < trace_next_; i++) {
+    const TraceEntry& entry = trace_[i % kTraceSize];
+    fprintf(out, "%" PRIx64 ": %s\n",
+            entry.offset, formatEvent(entry.event, entry.args).c_str());
+  }
+}
+
+// Costs a branch when logging is off.
+inline void DumpDebugScanner::logEvent(int event, uint64_t a0, uint64_t a1,
+                                       uint64_t a2, uint64_t a3) {
+  if (__builtin_expect(log_mode_ == LOG_OFF, 1))
+    return;
+  uint64_t args[4] = { a0, a1, a2, a3 };
+  logEventSlow(event, args);
+}
+
+void DumpDebugScanner::logEventSlow(int event, const uint64_t* args) {
+  if (log_mode_ == LOG_VERBOSE) {
+    fprintf(stderr, "%" PRIx64 ": %s\n",
+            offset_, formatEvent(event, args).c_str());
+    return;
+  }
+  if (trace_.empty())
+    trace_.resize(kTraceSize);
+  TraceEntry* entry = &trace_[trace_next_++ % kTraceSize];
+  entry->offset = offset_;
+  entry->event = event;
+  memcpy(entry->args, args, sizeof(entry->args));
+}
+
+void DumpDebugScanner::onCU(CU* cu, uint64_t offset) {
+  if (stream_out_) {
+    flushCU();
+    type_index_.reset(offset);
+  }
+  offset_ = offset;
+  last_func_ = NO_FUNC;
+  last_type_ = Type::NONE;
+  open_structs_.clear();
+  logEvent(EVENT_CU, cu_cnt_, cu->length, cu->version, cu->ptrsize);
+  cu_cnt_++;
+  cu_types_.resize(cu_cnt_ + 1);
+  cu_begin_ = offset;
+  cu_end_ = offset + cu->length + 4;
+}
+
+void DumpDebugScanner::onDIEs(const DIEBatch& batch) {
+  for (size_t i = 0; i < batch.size(); i++) {
+    const DIERecord& die = batch[i];
+    // Anything but parameters ends the parameter list, including DIEs
+    // which were not handed to us.
+    if (!wantsTag(die.prev_tag) ||
+        (die.tag != DW_TAG_formal_parameter &&
+         die.tag != DW_TAG_unspecified_parameters)) {
+      last_func_ = NO_FUNC;
+    }
+    if (die.depth != last_type_depth_ + 1)
+      last_type_ = Type::NONE;
+    while (!open_structs_.empty() && open_structs_.back().depth >= die.depth)
+      open_structs_.pop_back();
+    if (!wantsAttrs(die.tag))
+      continue;
+    setAttrs(die);
+    handleDIE(die.tag, die.prev_tag);
+  }
+}
+
+inline void DumpDebugScanner::setAttrs(const DIERecord& die) {
+  offset_ = die.offset;
+  depth_ = die.depth;
+  present_ = 0;
+  for (uint32_t j = 0; j < die.num_attrs; j++) {
+    const AttrValue& attr = die.attrs[j];
+    int slot = getSlot(attr.name);
+    if (slot < 0)
+      continue;
+    CHECK(!(present_ & (1 << slot)), offset_,
+          "Duplicated name: %d", (int)attr.name);
+    present_ |= 1 << slot;
+    values_[slot] = &attr;
+  }
+}
+
+void DumpDebugScanner::handleDIE(uint16_t tag, uint16_t prev_tag) {
+  switch (tag) {
+  case DW_TAG_base_type:
+    handleBaseType();
+    break;
+  case DW_TAG_typedef:
+    handleTypedef();
+    break;
+  case DW_TAG_structure_type:
+    handleStruct(Type::TYPE_STRUCT);
+    break;
+  case DW_TAG_union_type:
+    handleStruct(Type::TYPE_UNION);
+    break;
+  case DW_TAG_enumeration_type:
+    handleStruct(Type::TYPE_ENUM);
+    break;
+  case DW_TAG_pointer_type:
+    handleQualifiler(Type::TYPE_POINTER);
+    break;
+  case DW_TAG_array_type:
+    handleArray();
+    break;
+  case DW_TAG_subrange_type:
+    handleSubrange();
+    break;
+  case DW_TAG_const_type:
+    handleQualifiler(Type::TYPE_CONST);
+    break;
+  case DW_TAG_volatile_type:
+    handleQualifiler(Type::TYPE_VOLATILE);
+    break;
+  case DW_TAG_restrict_type:
+    handleQualifiler(Type::TYPE_RESTRICT);
+    break;
+  case DW_TAG_subroutine_type:
+    handleSubroutine();
+    break;
+  case DW_TAG_subprogram:
+    handleFunction();
+    break;
+  case DW_TAG_formal_parameter:
+    if (prev_tag == DW_TAG_subprogram ||
+        prev_tag == DW_TAG_subroutine_type ||
+        prev_tag == DW_TAG_formal_parameter) {
+      handleParameter();
+    }
+    break;
+  case DW_TAG_unspecified_parameters:
+    if (prev_tag == DW_TAG_subprogram ||
+        prev_tag == DW_TAG_subroutine_type ||
+        prev_tag == DW_TAG_formal_parameter) {
+      handleUnspecifiedParameters();
+    }
+    break;
+  case DW_TAG_member:
+    handleMember(getMemberLocation(getAttr(DW_AT_data_member_location)));
+    break;
+  case DW_TAG_enumerator:
+    handleMember(getValueOrZero(DW_AT_const_value));
+    break;
+  }
+}
+
+void DumpDebugScanner::addType(const Type& type) {
+  uint32_t index = type_arena_.size();
+  if (loading_foreign_) {
+    foreign_types_[offset_] = index;
+  } else {
+    CHECK(type_index_.add(offset_) == index, offset_, "Duplicated offset");
+    cu_types_[cu_cnt_].push_back(index);
+  }
+  type_arena_.push_back(type);
+  type_arena_.back().offset = offset_;
+}
+
+void DumpDebugScanner::handleBaseType() {
+  uint64_t size = getValue(DW_AT_byte_size);
+  //uint64_t encoding = getValue(DW_AT_encoding);
+  const char* name = getStrOrNull(DW_AT_name);
+  if (!name)
+    name = "???";
+  logEvent(EVENT_BASE_TYPE, (uint64_t)name);
+  addType(Type(Type::TYPE_BASE, size, name));
+}
+
+void DumpDebugScanner::handleTypedef() {
+  uint64_t type = getType();
+  const char* name = getStr(DW_AT_name);
+  logEvent(EVENT_TYPEDEF, (uint64_t)name);
+  addType(Type(Type::TYPE_TYPEDEF, name, type));
+}
+
+void DumpDebugScanner::handleStruct(int type) {
+  uint64_t size = getValueOrZero(DW_AT_byte_size);
+  const char* name = getStrOrNull(DW_AT_name);
+  logEvent(EVENT_STRUCT, (uint64_t)name);
+  addType(Type(type, size, name));
+  if (dedup_types_) {
+    OpenStruct open = { (uint32_t)type_arena_.size() - 1, depth_, Type::NONE };
+    open_structs_.push_back(open);
+  }
+}
+
+void DumpDebugScanner::handleQualifiler(int qual) {
+  uint64_t type = getType();
+  const char* name = getStrOrNull(DW_AT_name);
+  logEvent(EVENT_QUALIFIER, (uint64_t)name, type);
+  addType(Type(qual, name, type));
+}
+
+// The bounds are the subrange children which follow.
+void DumpDebugScanner::handleArray() {
+  handleQualifiler(Type::TYPE_ARRAY);
+  if (!declarators_)
+    return;
+  last_type_ = type_arena_.size() - 1;
+  last_type_depth_ = depth_;
+  type_arena_.back().args_begin = type_args_.size();
+}
+
+// Lower bounds are taken to be 0, as they are in C.
+void DumpDebugScanner::handleSubrange() {
+  if (last_type_ == Type::NONE ||
+      type_arena_[last_type_].type != Type::TYPE_ARRAY) {
+    return;
+  }
+  const AttrValue* count = getAttr(DW_AT_count);
+  const AttrValue* upper_bound = getAttr(DW_AT_upper_bound);
+  uint64_t bound = UNKNOWN_BOUND;
+  if (count && count->kind == AttrValue::CONSTANT)
+    bound = count->value;
+  else if (upper_bound && upper_bound->kind == AttrValue::CONSTANT)
+    bound = upper_bound->value + 1;
+  if (bound >= UNKNOWN_BOUND)
+    bound = UNKNOWN_BOUND;
+  type_args_.push_back(bound);
+  type_arena_[last_type_].num_args++;
+}
+
+// The return type is the reference, and the parameters are the children
+// which follow.
+void DumpDebugScanner::handleSubroutine() {
+  last_func_ = NO_FUNC;
+  if (!declarators_) {
+    addType(Type(Type::TYPE_FUNC));
+    return;
+  }
+  Type type(Type::TYPE_FUNC, NULL, getType());
+  type.prototyped = getValueOrZero(DW_AT_prototyped);
+  type.args_begin = type_args_.size();
+  last_type_ = type_arena_.size();
+  last_type_depth_ = depth_;
+  addType(type);
+}
+
+void DumpDebugScanner::handleFunction() {
+  uint64_t ret = getType();
+  const char* name = getStrOrNull(DW_AT_name);
+  uint64_t external = getValueOrZero(DW_AT_external);
+  if (!name)
+    return;
+  logEvent(EVENT_FUNCTION, (uint64_t)name, ret);
+  last_func_ = funcs_.size();
+  funcs_.push_back(Func());
+  Func* func = &funcs_.back();
+  func->ret = ret;
+  func->offset = offset_;
+  func->name = name;
+  func->args_begin = func_args_.size();
+  func->num_args = 0;
+  func->cu_id = cu_cnt_;
+  func->external = external;
+}
+
+void DumpDebugScanner::handleParameter() {
+  if (last_func_ == NO_FUNC && last_type_ == Type::NONE)
+    return;
+  uint64_t type = getType();
+  addArg(type);
+}
+
+void DumpDebugScanner::handleUnspecifiedParameters() {
+  if (last_func_ == NO_FUNC && last_type_ == Type::NONE)
+    return;
+  addArg(VAARG_OFFSET);
+}
+
+void DumpDebugScanner::addArg(uint64_t type) {
+  if (last_type_ != Type::NONE) {
+    if (type_arena_[last_type_].type != Type::TYPE_FUNC)
+      return;
+    type_args_.push_back(type);
+    type_arena_[last_type_].num_args++;
+    return;
+  }
+  func_args_.push_back(type);
+  funcs_[last_func_].num_args++;
+}
+
+void DumpDebugScanner::handleMember(uint64_t location) {
+  if (open_structs_.empty() || open_structs_.back().depth + 1 != depth_)
+    return;
+  OpenStruct* open = &open_structs_.back();
+  uint32_t index = members_.size();
+  Member member = { getStrOrNull(DW_AT_name), location, getType(),
+                    Type::NONE };
+  members_.push_back(member);
+  if (open->last_member == Type::NONE)
+    type_arena_[open->index].args_begin = index;
+  else
+    members_[open->last_member].next = index;
+  open->last_member = index;
+  type_arena_[open->index].num_args++;
+}
+
+int DumpDebugScanner::getSlot(int name) {
+  switch (name) {
+  case DW_AT_name:
+    return SLOT_NAME;
+  case DW_AT_type:
+    return SLOT_TYPE;
+  case DW_AT_byte_size:
+    return SLOT_BYTE_SIZE;
+  case DW_AT_external:
+    return SLOT_EXTERNAL;
+  case DW_AT_prototyped:
+    return SLOT_PROTOTYPED;
+  case DW_AT_count:
+    return SLOT_COUNT;
+  case DW_AT_upper_bound:
+    return SLOT_UPPER_BOUND;
+  case DW_AT_data_member_location:
+    return SLOT_MEMBER_LOCATION;
+  case DW_AT_const_value:
+    return SLOT_CONST_VALUE;
+  default:
+    return -1;
+  }
+}
+
+const AttrValue* DumpDebugScanner::getAttr(int name) const {
+  int slot = getSlot(name);
+  CHECK(slot >= 0, offset_, "No slot for name: %d", name);
+  return present_ & (1 << slot) ? values_[slot] : NULL;
+}
+
+const char* DumpDebugScanner::getStr(int name) const {
+  const AttrValue* attr = getAttr(name);
+  CHECK(attr && attr->kind == AttrValue::STRING, offset_,
+        "Name not found: %d", name);
+  return attr->data;
+}
+
+const char* DumpDebugScanner::getStrOrNull(int name) const {
+  const AttrValue* attr = getAttr(name);
+  if (!attr || attr->kind != AttrValue::STRING)
+    return NULL;
+  return attr->data;
+}
+
+// References are already absolute in DIEBatch.
+uint64_t DumpDebugScanner::getType() const {
+  return getValueOrZero(DW_AT_type);
+}
+
+uint64_t DumpDebugScanner::getValue(int name) const {
+  const AttrValue* attr = getAttr(name);
+  CHECK(attr, offset_, "Name not found: %d", name);
+  return attr->value;
+}
+
+uint64_t DumpDebugScanner::getValueOrZero(int name) const {
+  const AttrValue* attr = getAttr(name);
+  return attr ? attr->value : 0;
+}
+
+uint32_t DumpDebugScanner::getTypeIndex(uint64_t offset) {
+  uint32_t index = type_index_.find(offset);
+  if (index == OffsetIndex::NOT_FOUND && (stream_out_ || lazy_types_)) {
+    unordered_map<uint64_t, uint32_t>::const_iterator found =
+      foreign_types_.find(offset);
+    if (found != foreign_types_.end())
+      return found->second;
+    if (lazy_types_ || offset < cu_begin_ || offset >= cu_end_)
+      return loadForeignType(offset);
+  }
+  CHECK(index != OffsetIndex::NOT_FOUND, offset_,
+        "Type %" PRIx64 " not found", offset);
+  return index;
+}
+
+// Reads the type at |offset| in a CU which was already streamed out or is
+// yet to come, with the children declarators and dedup need.
+uint32_t DumpDebugScanner::loadForeignType(uint64_t offset) {
+  uint64_t saved_offset = offset_;
+  int saved_depth = depth_;
+  uint32_t saved_last_type = last_type_;
+  int saved_last_type_depth = last_type_depth_;
+  vector<OpenStruct> saved_open_structs;
+  saved_open_structs.swap(open_structs_);
+  if (stream_out_ && (offset < cu_begin_ || offset >= cu_end_))
+    checkForeignType(offset);
+  readDIE(offset, &foreign_batch_, declarators_ || dedup_types_);
+  const DIERecord& die = foreign_batch_[0];
+  CHECK(isTypeTag(die.tag), saved_offset,
+        "Type %" PRIx64 " not found", offset);
+  uint32_t index = type_arena_.size();
+  last_type_ = Type::NONE;
+  loading_foreign_ = true;
+  for (size_t i = 0; i < foreign_batch_.size(); i++) {
+    const DIERecord& child = foreign_batch_[i];
+    while (!open_structs_.empty() &&
+           open_structs_.back().depth >= child.depth) {
+      open_structs_.pop_back();
+    }
+    bool is_arg = (last_type_ != Type::NONE && wantsTag(child.tag) &&
+                   child.depth == last_type_depth_ + 1);
+    bool is_member = (!open_structs_.empty() &&
+                      (child.tag == DW_TAG_member ||
+                       child.tag == DW_TAG_enumerator));
+    if (i && !is_arg && !is_member)
+      continue;
+    setAttrs(child);
+    handleDIE(child.tag, child.prev_tag);
+  }
+  loading_foreign_ = false;
+  offset_ = saved_offset;
+  depth_ = saved_depth;
+  last_type_ = saved_last_type;
+  last_type_depth_ = saved_last_type_depth;
+  open_structs_.swap(saved_open_structs);
+  return index;
+}
+
+// Streaming reads types of other CUs before runBatched() gets to them, or
+// after it forgot them, so their CU is decoded whole first. This throws
+// what runBatched() would for a broken CU, and "not found" for offsets
+// which are not those of a type DIE, before anything of the CU is used.
+void DumpDebugScanner::checkForeignType(uint64_t offset) {
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+  const uint8_t* cu_start = findCUOf(offset);
+  CHECK(cu_start, offset_, "Type %" PRIx64 " not found", offset);
+  uint64_t cu_offset = cu_start - dinfo_start;
+  unordered_map<uint64_t, vector<uint64_t> >::iterator found =
+    foreign_cu_types_.find(cu_offset);
+  if (found == foreign_cu_types_.end()) {
+    readDIE(cu_offset + sizeof(CU), &foreign_batch_, true);
+    vector<uint64_t>* types = &foreign_cu_types_[cu_offset];
+    // The depth below which runBatched() would skip the children.
+    int skip_depth = INT_MAX;
+    for (size_t i = 0; i < foreign_batch_.size(); i++) {
+      const DIERecord& die = foreign_batch_[i];
+      if (die.depth > skip_depth)
+        continue;
+      skip_depth = wantsChildren(die.tag) ? INT_MAX : die.depth;
+      if (isTypeTag(die.tag))
+        types->push_back(die.offset);
+    }
+    found = foreign_cu_types_.find(cu_offset);
+  }
+  CHECK(binary_search(found->second.begin(), found->second.end(), offset),
+        offset_, "Type %" PRIx64 " not found", offset);
+}
+
+// Interns the types |index| refers to first. Structs are interned by name
+// and size rather than by members, so pointers to them end there, and any
+// other cycle can only come from broken DWARF. Dedup tells their
+// definitions apart with getStructLayout(). With declarators, function
+// types are also told apart by their parameters and arrays by their
+// bounds.
+uint32_t DumpDebugScanner::getCanonicalType(uint32_t index) {
+  uint32_t canonical = type_arena_[index].canonical;
+  CHECK(canonical != CANONICALIZING, type_arena_[index].offset,
+        "Type cycle");
+  if (canonical != Type::NONE)
+    return canonical;
+  type_arena_[index].canonical = CANONICALIZING;
+  uint64_t ref = type_arena_[index].ref;
+  uint32_t ref_id = TypeTable::NONE;
+  if (!isSpecialTypeOffset(ref)) {
+    if (type_arena_[index].ref_type == Type::NONE) {
+      uint32_t ref_type = getTypeIndex(ref);
+      type_arena_[index].ref_type = ref_type;
+    }
+    ref_id = getCanonicalType(type_arena_[index].ref_type);
+  }
+
+  uint32_t list = TypeTable::NONE;
+  uint8_t kind = type_arena_[index].type;
+  if (declarators_ && (kind == Type::TYPE_FUNC || kind == Type::TYPE_ARRAY)) {
+    vector<uint32_t> items;
+    // The arena may grow while the parameters are resolved.
+    for (uint32_t i = 0; i < type_arena_[index].num_args; i++) {
+      uint64_t arg = type_args_[type_arena_[index].args_begin + i];
+      uint32_t item;
+      if (kind == Type::TYPE_ARRAY)
+        item = arg;
+      else if (arg == VAARG_OFFSET)
+        item = VAARG_ID;
+      else if (!arg)
+        item = TypeTable::NONE;
+      else
+        item = getCanonicalType(getTypeIndex(arg));
+      items.push_back(item);
+    }
+    list = canonical_types_.internList(items.data(), items.size());
+  }
+
+  const Type& type = type_arena_[index];
+  // Function types have no size, so it tells whether they are prototyped.
+  canonical = canonical_types_.intern(type.type, type.name,
+                                      type.prototyped ? 1 : type.size,
+                                      ref_id, list);
+  type_arena_[index].canonical = canonical;
+  return canonical;
+}
+
+// Interns a struct, union or enum with the name, location and canonical
+// type of each member. The member types refer to structs by name and size
+// as usual, which ends cycles through pointers.
+uint32_t DumpDebugScanner::getStructLayout(uint32_t index) {
+  vector<uint32_t> items;
+  uint32_t next = type_arena_[index].args_begin;
+  // The arena and members_ may grow while the members are resolved.
+  for (uint32_t i = 0; i < type_arena_[index].num_args; i++) {
+    Member member = members_[next];
+    uint32_t type = TypeTable::NONE;
+    if (member.type)
+      type = getCanonicalType(getTypeIndex(member.type));
+    items.push_back(canonical_types_.intern(Type::TYPE_MEMBER, member.name,
+                                            (int32_t)member.location, type));
+    next = member.next;
+  }
+  uint32_t list = canonical_types_.internList(items.data(), items.size());
+  const Type& type = type_arena_[index];
+  return canonical_types_.intern(type.type, type.name, type.size,
+                                 TypeTable::NONE, list);
+}
+
+// Names are made once per canonical type, from the names of the types
+// they refer to.
+string_view DumpDebugScanner::getCanonicalName(uint32_t id) {
+  if (id < type_names_.size() && type_names_[id].data())
+    return type_names_[id];
+
+  if (declarators_)
+    return setTypeName(id, makeDeclarator(id, ""));
+
+  const TypeTable::Entry type = canonical_types_.get(id);
+  string_view name;
+  string buf;
+  switch (type.type) {
+  case Type::TYPE_BASE:
+    name = type.name;
+    break;
+  case Type::TYPE_TYPEDEF:
+    // TODO(hamaji): OK?
+    name = (type.ref != TypeTable::NONE ?
+            getCanonicalName(type.ref) : "<anonymous>");
+    break;
+  case Type::TYPE_STRUCT:
+  case Type::TYPE_UNION:
+  case Type::TYPE_ENUM:
+    name = type.name ? type.name : "<anonymous>";
+    break;
+  case Type::TYPE_POINTER:
+    if (type.ref == TypeTable::NONE) {
+      name = "void*";
+      break;
+    }
+    buf = getCanonicalName(type.ref);
+    buf += '*';
+    name = buf;
+    break;
+  case Type::TYPE_ARRAY:
+    CHECK(type.ref != TypeTable::NONE, offset_, "Unresolved ref");
+    buf = getCanonicalName(type.ref);
+    buf += "[]";
+    name = buf;
+    break;
+  case Type::TYPE_CONST:
+  case Type::TYPE_VOLATILE:
+  case Type::TYPE_RESTRICT:
+    name = (type.ref != TypeTable::NONE ?
+            getCanonicalName(type.ref) : "void");
+    break;
+  case Type::TYPE_FUNC:
+    name = "<func>";
+    break;
+  default:
+    CHECK(false, offset_, "Unknown type: %d", type.type);
+  }
+  return setTypeName(id, name);
+}
+
+string_view DumpDebugScanner::setTypeName(uint32_t id, string_view name) {
+  name = type_name_pool_.intern(name);
+  if (id >= type_names_.size())
+    type_names_.resize(canonical_types_.size());
+  type_names_[id] = name;
+  return name;
+}
+
+// Arrays and functions bind tighter than pointers, so a pointer to one
+// needs parentheses.
+static string parenthesize(const string& inner) {
+  if (!inner.empty() && inner[0] == '*')
+    return '(' + inner + ')';
+  return inner;
+}
+
+// Writes type |id| as a C abstract declarator around |inner|, which is
+// what is made of it from the outside, like "*" for a pointer to it.
+// Qualifiers of pointers follow the "*", and other qualifiers lead.
+// Structs, unions and enums are written with their keyword.
+string DumpDebugScanner::makeDeclarator(uint32_t id, const string& inner) {
+  if (id != TypeTable::NONE && inner.empty() && id < type_names_.size() &&
+      type_names_[id].data()) {
+    return string(type_names_[id]);
+  }
+
+  const char* name = "void";
+  string tagged;
+  if (id != TypeTable::NONE) {
+    const TypeTable::Entry type = canonical_types_.get(id);
+    switch (type.type) {
+    case Type::TYPE_POINTER:
+      return makeDeclarator(type.ref, '*' + inner);
+
+    case Type::TYPE_CONST:
+    case Type::TYPE_VOLATILE:
+    case Type::TYPE_RESTRICT: {
+      const char* qual = (type.type == Type::TYPE_CONST ? "const" :
+                          type.type == Type::TYPE_VOLATILE ? "volatile" :
+                          "restrict");
+      if (type.ref != TypeTable::NONE &&
+          canonical_types_.get(type.ref).type == Type::TYPE_POINTER) {
+        return makeDeclarator(type.ref, string(" ") + qual + inner);
+      }
+      return string(qual) + ' ' + makeDeclarator(type.ref, inner);
+    }
+
+    case Type::TYPE_ARRAY: {
+      string decl = parenthesize(inner);
+      uint32_t num_bounds = 0;
+      const uint32_t* bounds = NULL;
+      if (type.list != TypeTable::NONE)
+        bounds = canonical_types_.getList(type.list, &num_bounds);
+      if (!num_bounds)
+        decl += "[]";
+      for (uint32_t i = 0; i < num_bounds; i++) {
+        decl += '[';
+        if (bounds[i] != UNKNOWN_BOUND)
+          decl += stringPrintf("%u", bounds[i]);
+        decl += ']';
+      }
+      return makeDeclarator(type.ref, decl);
+    }
+
+    case Type::TYPE_FUNC: {
+      string decl = parenthesize(inner) + '(';
+      uint32_t num_params = 0;
+      const uint32_t* params = NULL;
+      if (type.list != TypeTable::NONE)
+        params = canonical_types_.getList(type.list, &num_params);
+      // An unprototyped C function type has only unspecified parameters,
+      // which are written as nothing, while a prototyped one without any
+      // parameters takes void.
+      if (!type.size && num_params == 1 && params[0] == VAARG_ID)
+        num_params = 0;
+      else if (!num_params && type.size)
+        decl += "void";
+      for (uint32_t i = 0; i < num_params; i++) {
+        if (i)
+          decl += ", ";
+        if (params[i] == VAARG_ID)
+          decl += "...";
+        else
+          decl += makeDeclarator(params[i], "");
+      }
+      decl += ')';
+      return makeDeclarator(type.ref, decl);
+    }
+
+    case Type::TYPE_BASE:
+    case Type::TYPE_TYPEDEF:
+      name = type.name ? type.name : "<anonymous>";
+      break;
+
+    case Type::TYPE_STRUCT:
+    case Type::TYPE_UNION:
+    case Type::TYPE_ENUM:
+      tagged = (type.type == Type::TYPE_STRUCT ? "struct " :
+                type.type == Type::TYPE_UNION ? "union " : "enum ");
+      tagged += type.name ? type.name : "<anonymous>";
+      name = tagged.c_str();
+      break;
+
+    default:
+      CHECK(false, offset_, "Unknown type: %d", type.type);
+    }
+  }
+
+  if (inner.empty())
+    return name;
+  if (inner[0] == '*' || inner[0] == '[')
+    return name + inner;
+  return string(name) + ' ' + inner;
+}
+
+// The types the name is made of are resolved on the way, which only types
+// no CU reached in collectCUs() still need.
+string_view DumpDebugScanner::getTypeName(uint64_t offset) {
+  if (!offset)
+    return "void";
+  if (offset == VAARG_OFFSET)
+    return "...";
+  return getCanonicalName(getCanonicalType(getTypeIndex(offset)));
+}
@@ -0,0 +1,369 @@
+#ifndef DUMPER_H_
+#define DUMPER_H_
+
+#include <dwarf.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "offset_index.h"
+#include "scanner.h"
+#include "string_pool.h"
+#include "type_table.h"
+
+// Types live in one array and refer to each other by their index in it.
+struct Type {
+  enum {
+    TYPE_ERROR, TYPE_BASE, TYPE_TYPEDEF, TYPE_STRUCT,
+    TYPE_POINTER, TYPE_ARRAY, TYPE_CONST, TYPE_VOLATILE, TYPE_FUNC,
+    TYPE_RESTRICT, TYPE_UNION, TYPE_ENUM,
+    // Only in TypeTable, for the members of struct layouts.
+    TYPE_MEMBER
+  };
+  static const uint32_t NONE = 0xffffffff;
+
+  uint64_t offset;
+  uint64_t ref;
+  const char* name;
+  int32_t size;
+  // The index of the type at |ref| once it is resolved, or NONE.
+  uint32_t ref_type;
+  // The ID in DumpDebugScanner's TypeTable once it is known, or NONE.
+  uint32_t canonical;
+  // The parameters of a TYPE_FUNC or the bounds of a TYPE_ARRAY are
+  // num_args entries of DumpDebugScanner::type_args_ from args_begin on.
+  // They are only read for setDeclarators(). With setDedupTypes(), the
+  // num_args members of a struct, union or enum are chained from
+  // DumpDebugScanner::members_[args_begin] instead.
+  uint32_t args_begin;
+  uint32_t num_args;
+  uint8_t type;
+  // Whether a TYPE_FUNC has DW_AT_prototyped.
+  bool prototyped;
+
+  Type(int t)
+    : ref(0), name(NULL), size(0), ref_type(NONE), canonical(NONE),
+      args_begin(0), num_args(0), type(t), prototyped(false) {}
+  Type(int t, int s, const char* n)
+    : ref(0), name(n), size(s), ref_type(NONE), canonical(NONE),
+      args_begin(0), num_args(0), type(t), prototyped(false) {}
+  Type(int t, const char* n, uint64_t r)
+    : ref(r), name(n), size(0), ref_type(NONE), canonical(NONE),
+      args_begin(0), num_args(0), type(t), prototyped(false) {}
+
+  int getSize(const std::vector<Type>& types) const;
+
+  // Whether |type| is TYPE_STRUCT, TYPE_UNION or TYPE_ENUM, which are
+  // all listed as structs.
+  static bool isStruct(int type) {
+    return type == TYPE_STRUCT || type == TYPE_UNION || type == TYPE_ENUM;
+  }
+};
+
+struct DumpCU;
+struct RenderedCU;
+class DumpOutput;
+template <class T> class SPSCQueue;
+
+// The arguments of all functions are in one array, as parameters always
+// come right after their function.
+struct Func {
+  uint64_t ret;
+  uint64_t offset;
+  const char* name;
+  uint32_t args_begin;
+  uint32_t num_args;
+  int cu_id;
+  bool external;
+};
+
+// Collects the types and the external functions of a binary and dumps them
+// as JSON. All state is per instance and errors are thrown as CrefError, so
+// several binaries can be dumped at once.
+class DumpDebugScanner : public StaticScanner<DumpDebugScanner> {
+public:
+  // LOG_VERBOSE reports every CU, type and function to stderr. LOG_TRACE
+  // keeps the last of them in a ring buffer and only formats them in
+  // dumpTrace().
+  enum LogMode {
+    LOG_OFF, LOG_VERBOSE, LOG_TRACE
+  };
+
+  // FORMAT_JSON is one array with an object per CU. FORMAT_NDJSON writes
+  // the same objects one per line, so they can be read one at a time.
+  // FORMAT_BINARY is a result file for ResultReader, which is only written
+  // once everything is collected.
+  enum Format {
+    FORMAT_JSON, FORMAT_NDJSON, FORMAT_BINARY
+  };
+
+  explicit DumpDebugScanner(Binary* binary);
+  ~DumpDebugScanner();
+
+  void setLogMode(LogMode mode) { log_mode_ = mode; }
+  void setFormat(Format format) { format_ = format; }
+  // Lists each distinct type only in the first CU which has it, instead of
+  // in every CU. Types are told apart by structure, see TypeTable, and
+  // structs, unions and enums also by their members. Must be set before
+  // scanning, as it makes the scan read the members.
+  void setDedupTypes(bool dedup) { dedup_types_ = dedup; }
+  // Writes types as C declarators, like "const char*", "struct stat*" and
+  // "int (*)(const char*, size_t)", which keep typedef names, qualifiers,
+  // array bounds and function signatures. Typedefs then name the type they
+  // are defined as rather than the one at the end of the chain. Must be
+  // set before scanning, as it makes the scan read more.
+  void setDeclarators(bool declarators) { declarators_ = declarators; }
+  // Skips the attributes of type DIEs while scanning, and decodes types
+  // with readDIE() only when a dumped function or a type it reaches first
+  // refers to them. Each CU then lists only the types its dumped
+  // functions reach instead of all of its types, and errors in types
+  // nobody reaches go unnoticed. Ignored for DWARF-zip binaries. Must be
+  // set before scanning.
+  void setLazyTypes(bool lazy);
+  // Dumps only the external functions named in |names|, and so only the
+  // CUs which define them. All are dumped if |names| is empty.
+  void setFuncs(const std::vector<std::string>& names);
+
+  // Makes runBatched() write each CU to |out| as soon as the next one
+  // starts, and forget it, so memory is bounded by the largest CU instead
+  // of the binary. Types in other CUs are read again with readDIE() when
+  // they are referenced. dump() must then be given the same |out|, and
+  // only finishes the output. The output is the same either way, but
+  // FORMAT_BINARY still keeps its tables until dump().
+  void setStreamOutput(FILE* out) { stream_out_ = out; }
+
+  // Writes what runBatched() collected.
+  void dump(FILE* out);
+
+  // Scans the binary and writes it to |out| like setStreamOutput(out),
+  // runBatched(1) and dump(out) would, but in three stages on their own
+  // threads: while one CU is decoded, the one before it is resolved and
+  // the one before that is written. Only the middle stage touches the
+  // scanner, and the order of the output stays the same.
+  void dumpPipelined(FILE* out);
+
+  // Writes the events kept by LOG_TRACE, oldest first.
+  void dumpTrace(FILE* out) const;
+
+private:
+  friend class StaticScanner<DumpDebugScanner>;
+
+  enum LogEvent {
+    EVENT_CU, EVENT_BASE_TYPE, EVENT_TYPEDEF, EVENT_STRUCT, EVENT_QUALIFIER,
+    EVENT_FUNCTION
+  };
+
+  struct TraceEntry {
+    uint64_t offset;
+    // Strings are kept as pointers into the binary.
+    uint64_t args[4];
+    int event;
+  };
+
+  // The attributes we look at, and where their values are kept.
+  enum {
+    SLOT_NAME, SLOT_TYPE, SLOT_BYTE_SIZE, SLOT_EXTERNAL, SLOT_PROTOTYPED,
+    SLOT_COUNT, SLOT_UPPER_BOUND, SLOT_MEMBER_LOCATION, SLOT_CONST_VALUE,
+    NUM_SLOTS
+  };
+
+  // A member of a struct or union, or an enumerator, whose |location| is
+  // its DW_AT_data_member_location or DW_AT_const_value. The members of a
+  // type are chained by |next|, as nested types come between them.
+  struct Member {
+    const char* name;
+    uint64_t location;
+    uint64_t type;
+    uint32_t next;
+  };
+
+  // A struct, union or enum whose members at depth + 1 are being read.
+  struct OpenStruct {
+    uint32_t index;
+    int depth;
+    // The index in members_ of its last member so far, or Type::NONE.
+    uint32_t last_member;
+  };
+
+  static const uint32_t NO_FUNC = 0xffffffff;
+  // How many resolved CUs may wait for the writer of dumpPipelined().
+  static const size_t kEmitDepth = 4;
+
+  bool wantsTag(uint16_t tag) const {
+    return (tag == DW_TAG_base_type ||
+            tag == DW_TAG_typedef ||
+            tag == DW_TAG_structure_type ||
+            tag == DW_TAG_union_type ||
+            tag == DW_TAG_enumeration_type ||
+            tag == DW_TAG_pointer_type ||
+            tag == DW_TAG_array_type ||
+            tag == DW_TAG_const_type ||
+            tag == DW_TAG_volatile_type ||
+            tag == DW_TAG_restrict_type ||
+            tag == DW_TAG_subroutine_type ||
+            tag == DW_TAG_subprogram ||
+            tag == DW_TAG_formal_parameter ||
+            tag == DW_TAG_unspecified_parameters ||
+            (tag == DW_TAG_subrange_type && declarators_) ||
+            ((tag == DW_TAG_member || tag == DW_TAG_enumerator) &&
+             dedup_types_));
+  }
+
+  // Whether DIEs with |tag| are types we read.
+  bool isTypeTag(uint16_t tag) const {
+    return (wantsTag(tag) &&
+            tag != DW_TAG_subprogram &&
+            tag != DW_TAG_formal_parameter &&
+            tag != DW_TAG_unspecified_parameters &&
+            tag != DW_TAG_subrange_type &&
+            tag != DW_TAG_member &&
+            tag != DW_TAG_enumerator);
+  }
+
+  // Types are left for loadForeignType() in lazy mode.
+  bool wantsAttrs(uint16_t tag) const {
+    return (!lazy_types_ ||
+            tag == DW_TAG_subprogram ||
+            tag == DW_TAG_formal_parameter ||
+            tag == DW_TAG_unspecified_parameters);
+  }
+
+  // Nothing below these defines a type or a function signature. Lexical
+  // blocks may hold local types which CU level pointers refer to, so they
+  // are still scanned. Declarators need the bounds of arrays and the
+  // parameters of function types, which readDIE() gets in lazy mode.
+  // Dedup needs the enumerators.
+  bool wantsChildren(uint16_t tag) const {
+    return (tag != DW_TAG_inlined_subroutine &&
+            tag != DW_TAG_GNU_call_site &&
+            (tag != DW_TAG_enumeration_type || dedup_types_) &&
+            ((tag != DW_TAG_array_type &&
+              tag != DW_TAG_subroutine_type) ||
+             (declarators_ && !lazy_types_)));
+  }
+
+  void onCU(CU* cu, uint64_t offset);
+  void onDIEs(const DIEBatch& batch);
+
+  void collectCUs(std::vector<std::unique_ptr<DumpCU> >* cus);
+  void renderCU(const DumpCU& cu, RenderedCU* out);
+  void flushCU();
+
+  void setAttrs(const DIERecord& die);
+  void handleDIE(uint16_t tag, uint16_t prev_tag);
+  void addType(const Type& type);
+  void handleBaseType();
+  void handleTypedef();
+  void handleStruct(int type);
+  void handleQualifiler(int qual);
+  void handleArray();
+  void handleSubrange();
+  void handleSubroutine();
+  void handleFunction();
+  void handleParameter();
+  void handleUnspecifiedParameters();
+  void addArg(uint64_t type);
+  void handleMember(uint64_t location);
+
+  static int getSlot(int name);
+  const AttrValue* getAttr(int name) const;
+  const char* getStr(int name) const;
+  const char* getStrOrNull(int name) const;
+  uint64_t getType() const;
+  uint64_t getValue(int name) const;
+  uint64_t getValueOrZero(int name) const;
+  uint32_t getTypeIndex(uint64_t offset);
+  uint32_t loadForeignType(uint64_t offset);
+  void checkForeignType(uint64_t offset);
+  uint32_t getCanonicalType(uint32_t index);
+  uint32_t getStructLayout(uint32_t index);
+  std::string_view getCanonicalName(uint32_t id);
+  std::string_view setTypeName(uint32_t id, std::string_view name);
+  std::string makeDeclarator(uint32_t id, const std::string& inner);
+  std::string_view getTypeName(uint64_t offset);
+
+  void logEvent(int event, uint64_t a0 = 0, uint64_t a1 = 0,
+                uint64_t a2 = 0, uint64_t a3 = 0);
+  void logEventSlow(int event, const uint64_t* args);
+  static std::string formatEvent(int event, const uint64_t* args);
+
+  // The DIE being handled, for diagnostics.
+  uint64_t offset_;
+  int depth_;
+
+  int cu_cnt_;
+
+  std::vector<Type> type_arena_;
+  // From offsets to indices of type_arena_.
+  OffsetIndex type_index_;
+  // The types in each CU, indexed by cu_id.
+  std::vector<std::vector<uint32_t> > cu_types_;
+  std::vector<Func> funcs_;
+  std::vector<uint64_t> func_args_;
+  // The index of the function whose parameters are being read, or NO_FUNC.
+  uint32_t last_func_;
+  // Parameter types of TYPE_FUNC, as offsets like func_args_, and bounds
+  // of TYPE_ARRAY, as numbers of elements.
+  std::vector<uint64_t> type_args_;
+  // The index of the type whose children at last_type_depth_ + 1 are
+  // being read into type_args_, or Type::NONE.
+  uint32_t last_type_;
+  int last_type_depth_;
+  // For setDedupTypes().
+  std::vector<Member> members_;
+  std::vector<OpenStruct> open_structs_;
+
+  Format format_;
+
+  // All types seen so far, by structure. Unlike type_arena_, this is kept
+  // while streaming, and so is which of them were written.
+  TypeTable canonical_types_;
+  std::vector<bool> written_types_;
+  // The names of canonical_types_ by ID, once they are made. They point
+  // into type_name_pool_, so RenderedCU can refer to them as they are.
+  std::vector<std::string_view> type_names_;
+  StringPool type_name_pool_;
+  bool dedup_types_;
+  bool declarators_;
+
+  // For setLazyTypes(). cu_types_ stays empty, and all types are in
+  // foreign_types_.
+  bool lazy_types_;
+  // For setFuncs().
+  std::unordered_set<std::string> wanted_funcs_;
+
+  // For setStreamOutput(). The arrays above only hold the current CU, and
+  // types read from other CUs are indexed by foreign_types_ instead.
+  FILE* stream_out_;
+  std::unique_ptr<DumpOutput> stream_output_;
+  // Where flushCU() hands CUs to the writer of dumpPipelined(), or NULL.
+  SPSCQueue<std::unique_ptr<RenderedCU> >* emit_queue_;
+  int num_streamed_;
+  uint64_t cu_begin_;
+  uint64_t cu_end_;
+  std::unordered_map<uint64_t, uint32_t> foreign_types_;
+  // The offsets of the type DIEs runBatched() would see in each CU
+  // checkForeignType() has decoded, by the offset of the CU.
+  std::unordered_map<uint64_t, std::vector<uint64_t> > foreign_cu_types_;
+  DIEBatch foreign_batch_;
+  bool loading_foreign_;
+
+  // The attributes of the DIE being handled, by slot. They point into the
+  // batch and are only valid if their bit in present_ is set.
+  const AttrValue* values_[NUM_SLOTS];
+  uint32_t present_;
+
+  LogMode log_mode_;
+  std::vector<TraceEntry> trace_;
+  size_t trace_next_;
+};
+
+extern template void StaticScanner<DumpDebugScanner>::runBatched(int);
+
+#endif  // DUMPER_H_
@@ -5,21 +5,21 @@ require 'cgi'
 require 'json'
 
 FILENAMES = %w(
-libc-2.18-x64.json
-libc-2.18-i686.json
-libc-2.17-x32.json
-libc-2.9-nacl-x64.json
-libc-2.9-nacl-i686.json
+libc-2.18-x64.ndjson
+libc-2.18-i686.ndjson
+libc-2.17-x32.ndjson
+libc-2.9-nacl-x64.ndjson
+libc-2.9-nacl-i686.ndjson
 )
 
 all_infos = []
 all_types = {}
 FILENAMES.each do |filename|
-  json = JSON.load(File.read(filename))
   types = {}
   all_infos << types
-  json.each do |cu|
-    cu_type = cu['type']
+  # One CU per line, so only one is in memory at a time.
+  File.foreach(filename) do |line|
+    cu_type = JSON.parse(line)['type']
     cu_type.each do |name, info|
       all_types[name] = 1
 
@@ -52,7 +52,7 @@ print "sizeof(XXX)\t"
 #)
 #end
 
-puts %Q(#{FILENAMES.map{|fn|fn.sub(/\.json/, '')} * "\t"})
+puts %Q(#{FILENAMES.map{|fn|fn.sub(/\.ndjson/, '')} * "\t"})
 
 all_types.sort_by{|name, _|name == '???' ? '~~~' : name.upcase}.each do |name, _|
   tr = "#{name}"
@@ -0,0 +1,86 @@
+#include "json_writer.h"
+
+#include <errno.h>
+
+#include "util.h"
+
+using namespace std;
+
+JsonWriter::JsonWriter(FILE* out)
+  : out_(out),
+    buf_(kBufSize),
+    size_(0) {
+}
+
+// Destructors must not throw, so errors are only reported by flush().
+JsonWriter::~JsonWriter() {
+  if (size_)
+    fwrite(buf_.data(), 1, size_, out_);
+}
+
+void JsonWriter::flush() {
+  write(buf_.data(), size_);
+  size_ = 0;
+  if (fflush(out_) != 0 || ferror(out_))
+    throwError("write failed: %s", strerror(errno));
+}
+
+void JsonWriter::write(const char* s, size_t size) {
+  if (size && fwrite(s, 1, size, out_) != size)
+    throwError("write failed: %s", strerror(errno));
+}
+
+// Large pieces skip the buffer.
+void JsonWriter::rawSlow(const char* s, size_t size) {
+  write(buf_.data(), size_);
+  size_ = 0;
+  if (size >= kBufSize) {
+    write(s, size);
+    return;
+  }
+  memcpy(buf_.data(), s, size);
+  size_ = size;
+}
+
+// Names rarely need escaping, so runs of plain bytes are copied at once.
+void JsonWriter::quoted(string_view s) {
+  static const char kHex[] = "0123456789abcdef";
+  raw('"');
+  size_t begin = 0;
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    raw(s.data() + begin, i - begin);
+    begin = i + 1;
+    switch (c) {
+    case '"':
+      raw("\\\"", 2);
+      break;
+    case '\\':
+      raw("\\\\", 2);
+      break;
+    case '\b':
+      raw("\\b", 2);
+      break;
+    case '\f':
+      raw("\\f", 2);
+      break;
+    case '\n':
+      raw("\\n", 2);
+      break;
+    case '\r':
+      raw("\\r", 2);
+      break;
+    case '\t':
+      raw("\\t", 2);
+      break;
+    default: {
+      char escaped[6] = { '\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 15] };
+      raw(escaped, sizeof(escaped));
+    }
+    }
+  }
+  raw(s.data() + begin, s.size() - begin);
+  raw('"');
+}
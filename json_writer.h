@@ -0,0 +1,81 @@
+#ifndef JSON_WRITER_H_
+#define JSON_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string_view>
+#include <vector>
+
+// Writes JSON text to a FILE through a buffer of its own, which is only
+// handed to stdio when it is full or flushed. Strings are escaped and
+// integers are formatted without printf. The caller takes care of the
+// structure, with raw() for punctuation.
+class JsonWriter {
+public:
+  explicit JsonWriter(FILE* out);
+  // Hands what is left to stdio, but ignores errors. Call flush() to see
+  // them.
+  ~JsonWriter();
+
+  void raw(const char* s, size_t size) {
+    if (size > kBufSize - size_) {
+      rawSlow(s, size);
+      return;
+    }
+    memcpy(&buf_[size_], s, size);
+    size_ += size;
+  }
+
+  void raw(std::string_view s) { raw(s.data(), s.size()); }
+
+  void raw(char c) {
+    if (size_ == kBufSize) {
+      write(buf_.data(), size_);
+      size_ = 0;
+    }
+    buf_[size_++] = c;
+  }
+
+  // Writes |s| quoted, escaping what JSON requires. Other bytes, including
+  // those of UTF-8 sequences, are written as they are.
+  void quoted(std::string_view s);
+
+  void integer(int64_t v) {
+    if (v < 0) {
+      raw('-');
+      unsignedInteger(-(uint64_t)v);
+    } else {
+      unsignedInteger(v);
+    }
+  }
+
+  void unsignedInteger(uint64_t v) {
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    do {
+      *--p = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    raw(p, digits + sizeof(digits) - p);
+  }
+
+  // Writes everything out, and also flushes the FILE. Throws a CrefError
+  // if anything written so far failed.
+  void flush();
+
+private:
+  static const size_t kBufSize = 1 << 16;
+
+  // Throws a CrefError on short writes.
+  void write(const char* s, size_t size);
+  void rawSlow(const char* s, size_t size);
+
+  FILE* out_;
+  std::vector<char> buf_;
+  size_t size_;
+};
+
+#endif  // JSON_WRITER_H_
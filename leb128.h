@@ -0,0 +1,111 @@
+#ifndef LEB128_H_
+#define LEB128_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// The decoders below may read up to kLEB128Overread bytes past the end of
+// a value. Binary makes sure that many readable bytes follow .debug_info
+// and .debug_abbrev.
+static const size_t kLEB128Overread = 7;
+
+static inline uint64_t loadWord(const uint8_t* p) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+// Packs the low 7 bits of each byte of |w| into a 56-bit integer.
+static inline uint64_t packLEB128Word(uint64_t w) {
+#if defined(__BMI2__)
+  return _pext_u64(w, 0x7f7f7f7f7f7f7f7fULL);
+#else
+  w &= 0x7f7f7f7f7f7f7f7fULL;
+  w = (w & 0x007f007f007f007fULL) | ((w & 0x7f007f007f007f00ULL) >> 1);
+  w = (w & 0x00003fff00003fffULL) | ((w & 0x3fff00003fff0000ULL) >> 2);
+  w = (w & 0x000000000fffffffULL) | ((w & 0x0fffffff00000000ULL) >> 4);
+  return w;
+#endif
+}
+
+// Decodes a LEB128 value of 3 or more bytes and returns its bits without
+// sign extension. |*shift| is set to the number of bits consumed.
+static inline uint64_t decodeLongLEB128(const uint8_t*& p, int* shift) {
+  uint64_t w = loadWord(p);
+  uint64_t stops = ~w & 0x8080808080808080ULL;
+  if (stops) {
+    // The lowest byte with a clear high bit ends the value.
+    int len = (__builtin_ctzll(stops) >> 3) + 1;
+    if (len < 8)
+      w &= (1ULL << (len * 8)) - 1;
+    p += len;
+    *shift = len * 7;
+    return packLEB128Word(w);
+  }
+
+  // More than 8 bytes, only seen for values of 57 bits or more.
+  uint64_t r = packLEB128Word(w);
+  int s = 56;
+  p += 8;
+  uint8_t b;
+  do {
+    b = *p++;
+    if (s < 64)
+      r |= (uint64_t)(b & 0x7f) << s;
+    s += 7;
+  } while (b >= 0x80);
+  *shift = s;
+  return r;
+}
+
+static inline uint64_t uleb128(const uint8_t*& p) {
+  uint8_t b0 = p[0];
+  if (b0 < 0x80) {
+    p++;
+    return b0;
+  }
+  uint8_t b1 = p[1];
+  if (b1 < 0x80) {
+    p += 2;
+    return (b0 & 0x7f) | (uint64_t)b1 << 7;
+  }
+  int shift;
+  return decodeLongLEB128(p, &shift);
+}
+
+static inline int64_t sleb128(const uint8_t*& p) {
+  uint8_t b0 = p[0];
+  if (b0 < 0x80) {
+    p++;
+    // Bit 6 is the sign bit of a single byte value.
+    return (int64_t)((uint64_t)b0 << 57) >> 57;
+  }
+  uint8_t b1 = p[1];
+  if (b1 < 0x80) {
+    p += 2;
+    uint64_t r = (b0 & 0x7f) | (uint64_t)b1 << 7;
+    return (int64_t)(r << 50) >> 50;
+  }
+  int shift;
+  uint64_t r = decodeLongLEB128(p, &shift);
+  if (shift < 64 && (r >> (shift - 1)) & 1)
+    r |= ~0ULL << shift;
+  return (int64_t)r;
+}
+
+static inline void skipLEB128(const uint8_t*& p) {
+  uint64_t stops = ~loadWord(p) & 0x8080808080808080ULL;
+  if (stops) {
+    p += (__builtin_ctzll(stops) >> 3) + 1;
+    return;
+  }
+  p += 8;
+  while (*p++ >= 0x80) {}
+}
+
+#endif  // LEB128_H_
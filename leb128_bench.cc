@@ -0,0 +1,156 @@
+// Measures LEB128 decode throughput of leb128.h against the byte-at-a-time
+// loop the scanner used before.
+//
+// Usage: ./leb128_bench [num_values]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include "leb128.h"
+
+using namespace std;
+
+static uint64_t uleb128Loop(const uint8_t*& p) {
+  uint64_t r = 0;
+  int s = 0;
+  do {
+    r |= (uint64_t)(*p & 0x7f) << s;
+    s += 7;
+  } while (*p++ >= 0x80);
+  return r;
+}
+
+static int64_t sleb128Loop(const uint8_t*& p) {
+  int64_t r = 0;
+  int s = 0;
+  for (;;) {
+    uint8_t b = *p++;
+    if (b < 0x80) {
+      if (b & 0x40) {
+        r -= (int64_t)(0x80 - b) << s;
+      }
+      else {
+        r |= (int64_t)(b & 0x3f) << s;
+      }
+      break;
+    }
+    r |= (int64_t)(b & 0x7f) << s;
+    s += 7;
+  }
+  return r;
+}
+
+static void encodeULEB128(uint64_t v, vector<uint8_t>* out) {
+  do {
+    uint8_t b = v & 0x7f;
+    v >>= 7;
+    if (v)
+      b |= 0x80;
+    out->push_back(b);
+  } while (v);
+}
+
+static void encodeSLEB128(int64_t v, vector<uint8_t>* out) {
+  while (true) {
+    uint8_t b = v & 0x7f;
+    v >>= 7;
+    if ((v == 0 && !(b & 0x40)) || (v == -1 && (b & 0x40))) {
+      out->push_back(b);
+      return;
+    }
+    out->push_back(b | 0x80);
+  }
+}
+
+// Picks a bit width with the rough shape of .debug_info: mostly abbrev
+// codes and small constants, some offsets and a few addresses. The last
+// profile also has values over 56 bits, which take 9 or 10 bytes and the
+// slow path of leb128.h.
+static int pickBits(int profile) {
+  int r = rand() % 100;
+  switch (profile) {
+  case 0:
+    return 7;
+  case 1:
+    return r < 70 ? 7 : r < 90 ? 14 : r < 98 ? 28 : 48;
+  default:
+    return r < 20 ? 14 : r < 50 ? 28 : r < 75 ? 48 : r < 90 ? 56 : 64;
+  }
+}
+
+// rand() only gives 31 bits at a time.
+static uint64_t rand64() {
+  return ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ rand();
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <class T>
+static double bench(const vector<uint8_t>& buf, size_t num_values,
+                    T (*decode)(const uint8_t*&), uint64_t* checksum) {
+  double best = 0;
+  for (int trial = 0; trial < 5; trial++) {
+    const uint8_t* p = &buf[0];
+    uint64_t sum = 0;
+    double start = now();
+    for (size_t i = 0; i < num_values; i++)
+      sum += (uint64_t)decode(p);
+    double rate = num_values / (now() - start);
+    if (rate > best)
+      best = rate;
+    *checksum = sum;
+  }
+  return best;
+}
+
+int main(int argc, char* argv[]) {
+  size_t num_values = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  static const char* kProfiles[] = {
+    "1 byte", "debug_info-like", "mostly long"
+  };
+
+  printf("%-16s %-6s %14s %14s %8s\n",
+         "profile", "kind", "loop (M/s)", "leb128.h (M/s)", "speedup");
+  for (int profile = 0; profile < 3; profile++) {
+    srand(profile + 1);
+    vector<uint8_t> ubuf, sbuf;
+    for (size_t i = 0; i < num_values; i++) {
+      int bits = pickBits(profile);
+      uint64_t v = rand64();
+      if (bits < 64)
+        v &= (1ULL << bits) - 1;
+      encodeULEB128(v, &ubuf);
+      encodeSLEB128((int64_t)(rand() % 2 ? v : 0 - v), &sbuf);
+    }
+    // leb128.h may read a word past the last value.
+    ubuf.resize(ubuf.size() + 8);
+    sbuf.resize(sbuf.size() + 8);
+
+    uint64_t expected, actual;
+    double loop = bench(ubuf, num_values, uleb128Loop, &expected);
+    double fast = bench(ubuf, num_values, uleb128, &actual);
+    if (expected != actual) {
+      fprintf(stderr, "uleb128 mismatch\n");
+      return 1;
+    }
+    printf("%-16s %-6s %14.1f %14.1f %7.2fx\n",
+           kProfiles[profile], "uleb", loop / 1e6, fast / 1e6, fast / loop);
+
+    loop = bench(sbuf, num_values, sleb128Loop, &expected);
+    fast = bench(sbuf, num_values, sleb128, &actual);
+    if (expected != actual) {
+      fprintf(stderr, "sleb128 mismatch\n");
+      return 1;
+    }
+    printf("%-16s %-6s %14.1f %14.1f %7.2fx\n",
+           kProfiles[profile], "sleb", loop / 1e6, fast / 1e6, fast / loop);
+  }
+}
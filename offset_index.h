@@ -0,0 +1,67 @@
+#ifndef OFFSET_INDEX_H_
+#define OFFSET_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Maps .debug_info offsets to the order they were added in. DIEs are
+// scanned in offset order, so this is an append-only sorted array with a
+// guide which tells, for every 2^kBucketShift bytes of .debug_info, where
+// its offsets start in the array. A lookup is a table access and a short
+// scan, and the guide costs 4 bytes per bucket from the base offset on.
+class OffsetIndex {
+public:
+  static const uint32_t NOT_FOUND = 0xffffffff;
+
+  OffsetIndex()
+    : base_(0) {
+  }
+
+  size_t size() const { return offsets_.size(); }
+
+  // Forgets all offsets. Those added from now on must be at least |base|,
+  // so an index which only ever holds one CU stays small.
+  void reset(uint64_t base) {
+    offsets_.clear();
+    starts_.clear();
+    base_ = base;
+  }
+
+  // Returns the index of |offset|, or NOT_FOUND if it is below the base or
+  // not greater than all offsets added so far.
+  uint32_t add(uint64_t offset) {
+    if (offset < base_ || (!offsets_.empty() && offsets_.back() >= offset))
+      return NOT_FOUND;
+    uint32_t index = offsets_.size();
+    size_t bucket = (offset - base_) >> kBucketShift;
+    if (bucket >= starts_.size())
+      starts_.resize(bucket + 1, index);
+    offsets_.push_back(offset);
+    return index;
+  }
+
+  uint32_t find(uint64_t offset) const {
+    size_t bucket = (offset - base_) >> kBucketShift;
+    if (offset < base_ || bucket >= starts_.size())
+      return NOT_FOUND;
+    size_t end = (bucket + 1 < starts_.size() ?
+                  starts_[bucket + 1] : offsets_.size());
+    for (size_t i = starts_[bucket]; i < end; i++) {
+      if (offsets_[i] >= offset)
+        return offsets_[i] == offset ? i : NOT_FOUND;
+    }
+    return NOT_FOUND;
+  }
+
+private:
+  static const int kBucketShift = 6;
+
+  uint64_t base_;
+  std::vector<uint64_t> offsets_;
+  // The index of the first offset in each bucket or after it.
+  std::vector<uint32_t> starts_;
+};
+
+#endif  // OFFSET_INDEX_H_
@@ -0,0 +1,88 @@
+#include <dwarf.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include "binary.h"
+#include "die_store.h"
+#include "util.h"
+
+using namespace std;
+
+// Answers a couple of questions about a binary from one DIEStore, as an
+// example of queries over its columns.
+
+static const char* nameOf(const DIEStore::Column& names, uint32_t i) {
+  const char* name = names.str(i);
+  return name ? name : "(anonymous)";
+}
+
+// Structs, unions and classes of more than |min_size| bytes.
+static void printLargeStructs(const DIEStore& store, uint64_t min_size) {
+  const uint16_t* tags = store.tags();
+  const uint64_t* offsets = store.offsets();
+  const DIEStore::Column& sizes = *store.column(DW_AT_byte_size);
+  const DIEStore::Column& names = *store.column(DW_AT_name);
+  for (uint32_t i = 0; i < store.size(); i++) {
+    if ((tags[i] == DW_TAG_structure_type ||
+         tags[i] == DW_TAG_union_type ||
+         tags[i] == DW_TAG_class_type) &&
+        sizes.kinds[i] == AttrValue::CONSTANT && sizes.values[i] > min_size) {
+      printf("%" PRIx64 " %s %" PRIu64 "\n",
+             offsets[i], nameOf(names, i), sizes.values[i]);
+    }
+  }
+}
+
+// Functions with more than |min_params| parameters.
+static void printManyParamFuncs(const DIEStore& store, uint32_t min_params) {
+  const uint16_t* tags = store.tags();
+  const uint64_t* offsets = store.offsets();
+  const DIEStore::Column& names = *store.column(DW_AT_name);
+  vector<uint32_t> params;
+  store.countChildren(DW_TAG_formal_parameter, &params);
+  for (uint32_t i = 0; i < store.size(); i++) {
+    if (tags[i] == DW_TAG_subprogram && params[i] > min_params) {
+      printf("%" PRIx64 " %s %u\n", offsets[i], nameOf(names, i), params[i]);
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int num_threads = 1;
+  if (argc > 1 && !strncmp(argv[1], "-j", 2)) {
+    num_threads = atoi(argv[1] + 2);
+    argc--;
+    argv++;
+  }
+  if (argc < 4 ||
+      (strcmp(argv[2], "structs") && strcmp(argv[2], "funcs"))) {
+    fprintf(stderr,
+            "Usage: %s [-j<threads>] binary structs <bytes>\n"
+            "       %s [-j<threads>] binary funcs <params>\n"
+            " structs: list structs larger than <bytes>\n"
+            " funcs: list functions with more than <params> parameters\n",
+            argv[0], argv[0]);
+    exit(1);
+  }
+
+  try {
+    unique_ptr<Binary> binary(readBinary(argv[1]));
+    vector<uint16_t> attr_names;
+    attr_names.push_back(DW_AT_name);
+    attr_names.push_back(DW_AT_byte_size);
+    DIEStore store(binary.get(), attr_names);
+    store.build(num_threads);
+    if (!strcmp(argv[2], "structs"))
+      printLargeStructs(store, strtoull(argv[3], NULL, 0));
+    else
+      printManyParamFuncs(store, strtoul(argv[3], NULL, 0));
+  } catch (const CrefError& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+}
@@ -0,0 +1,188 @@
+#include "result_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+
+using namespace std;
+
+ResultWriter::ResultWriter(FILE* out)
+  : out_(out),
+    pos_(0),
+    strings_(1, '\0') {
+}
+
+void ResultWriter::beginCU() {
+  ResultCU cu;
+  cu.types_begin = cu_types_.size();
+  cu.num_types = 0;
+  cu.funcs_begin = funcs_.size();
+  cu.num_funcs = 0;
+  cus_.push_back(cu);
+}
+
+void ResultWriter::addType(string_view name, uint32_t kind, int32_t size,
+                           string_view target) {
+  ResultType type;
+  type.name = intern(name);
+  type.kind = kind;
+  type.size = size;
+  type.target = intern(target);
+  pair<unordered_map<ResultType, uint32_t, TypeHash, TypeEqual>::iterator,
+       bool> inserted = type_ids_.insert(make_pair(type, types_.size()));
+  if (inserted.second)
+    types_.push_back(type);
+  cu_types_.push_back(inserted.first->second);
+  cus_.back().num_types++;
+}
+
+void ResultWriter::addFunc(string_view name, const string_view* types,
+                           size_t num_types) {
+  ResultFunc func;
+  func.name = intern(name);
+  func.types_begin = func_types_.size();
+  func.num_types = num_types;
+  for (size_t i = 0; i < num_types; i++)
+    func_types_.push_back(intern(types[i]));
+  funcs_.push_back(func);
+  cus_.back().num_funcs++;
+}
+
+uint32_t ResultWriter::intern(string_view str) {
+  if (str.empty())
+    return 0;
+  // Offsets into the strings are 32-bit in the file.
+  if (strings_.size() + str.size() + 1 > 0xffffffff)
+    throwError("Too many strings for a result file: %zu",
+               strings_.size() + str.size() + 1);
+  pair<unordered_map<string, uint32_t>::iterator, bool> inserted =
+    string_ids_.insert(make_pair(string(str), (uint32_t)strings_.size()));
+  if (inserted.second) {
+    strings_.append(str.data(), str.size());
+    strings_ += '\0';
+  }
+  return inserted.first->second;
+}
+
+// Pads to the 8-byte boundary finish() laid the array out at.
+void ResultWriter::writeArray(const void* data, size_t size) {
+  static const char kPadding[8] = {};
+  size_t padding = -pos_ & 7;
+  fwrite(kPadding, 1, padding, out_);
+  fwrite(data, 1, size, out_);
+  pos_ += padding + size;
+}
+
+void ResultWriter::finish() {
+  ResultHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kResultMagic, sizeof(header.magic));
+  header.version = kResultVersion;
+  header.num_cus = cus_.size();
+  header.num_types = types_.size();
+  header.num_funcs = funcs_.size();
+  header.num_cu_types = cu_types_.size();
+  header.num_func_types = func_types_.size();
+  header.strings_size = strings_.size();
+
+  // The arrays are laid out first, so that the header can be written
+  // before them and |out_| need not be seekable.
+  const void* arrays[] = {
+    cus_.data(), types_.data(), cu_types_.data(), funcs_.data(),
+    func_types_.data(), strings_.data()
+  };
+  size_t sizes[] = {
+    cus_.size() * sizeof(ResultCU),
+    types_.size() * sizeof(ResultType),
+    cu_types_.size() * sizeof(uint32_t),
+    funcs_.size() * sizeof(ResultFunc),
+    func_types_.size() * sizeof(uint32_t),
+    strings_.size()
+  };
+  uint64_t* offsets[] = {
+    &header.cus_offset, &header.types_offset, &header.cu_types_offset,
+    &header.funcs_offset, &header.func_types_offset, &header.strings_offset
+  };
+  static const size_t kNumArrays = sizeof(arrays) / sizeof(arrays[0]);
+  uint64_t pos = sizeof(header);
+  for (size_t i = 0; i < kNumArrays; i++) {
+    pos += -pos & 7;
+    *offsets[i] = pos;
+    pos += sizes[i];
+  }
+
+  fwrite(&header, 1, sizeof(header), out_);
+  pos_ = sizeof(header);
+  for (size_t i = 0; i < kNumArrays; i++)
+    writeArray(arrays[i], sizes[i]);
+  // fwrite() errors stick to |out_|, so one check covers all the writes.
+  if (fflush(out_) != 0 || ferror(out_))
+    throwError("write failed: %s", strerror(errno));
+}
+
+// Whether an array of |size| bytes at |offset| is within the file and
+// aligned for its records.
+bool ResultReader::fits(uint64_t offset, uint64_t size) const {
+  return offset % 8 == 0 && offset <= size_ && size <= size_ - offset;
+}
+
+ResultReader::ResultReader(const char* filename)
+  : filename_(filename),
+    mapped_(MAP_FAILED),
+    size_(0) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    throwError("open failed: %s", filename);
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    throwError("stat failed: %s", filename);
+  }
+  size_ = st.st_size;
+  if (size_ >= sizeof(ResultHeader))
+    mapped_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped_ == MAP_FAILED)
+    throwError("not a result file: %s", filename);
+
+  const char* p = (const char*)mapped_;
+  header_ = (const ResultHeader*)p;
+  const ResultHeader& h = *header_;
+  bool ok = (!memcmp(h.magic, kResultMagic, sizeof(kResultMagic)) &&
+             h.version == kResultVersion &&
+             fits(h.cus_offset, (uint64_t)h.num_cus * sizeof(ResultCU)) &&
+             fits(h.types_offset,
+                  (uint64_t)h.num_types * sizeof(ResultType)) &&
+             fits(h.cu_types_offset,
+                  (uint64_t)h.num_cu_types * sizeof(uint32_t)) &&
+             fits(h.funcs_offset,
+                  (uint64_t)h.num_funcs * sizeof(ResultFunc)) &&
+             fits(h.func_types_offset,
+                  (uint64_t)h.num_func_types * sizeof(uint32_t)) &&
+             fits(h.strings_offset, h.strings_size) &&
+             h.strings_size > 0 &&
+             p[h.strings_offset + h.strings_size - 1] == '\0');
+  if (!ok) {
+    munmap(mapped_, size_);
+    throwError("not a result file: %s", filename);
+  }
+  cus_ = (const ResultCU*)(p + h.cus_offset);
+  types_ = (const ResultType*)(p + h.types_offset);
+  cu_types_ = (const uint32_t*)(p + h.cu_types_offset);
+  funcs_ = (const ResultFunc*)(p + h.funcs_offset);
+  func_types_ = (const uint32_t*)(p + h.func_types_offset);
+  strings_ = p + h.strings_offset;
+}
+
+ResultReader::~ResultReader() {
+  munmap(mapped_, size_);
+}
+
+void ResultReader::fail() const {
+  throwError("broken result file: %s", filename_.c_str());
+}
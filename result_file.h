@@ -0,0 +1,184 @@
+#ifndef RESULT_FILE_H_
+#define RESULT_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A binary form of what dump_debug_info writes as JSON, meant to be mapped
+// and read in place. After the header come five arrays of fixed-width
+// records and a string table, each 8-byte aligned and in the byte order of
+// the writer. Strings are offsets into the string table, which holds each
+// distinct string once, NUL terminated. Offset 0 is the empty string.
+// Types are kept once as well, and CUs list the indices of theirs.
+
+static const char kResultMagic[8] = { 'C', 'R', 'E', 'F', 'R', 'E', 'S', 0 };
+static const uint32_t kResultVersion = 2;
+
+struct ResultHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_cus;
+  uint32_t num_types;
+  uint32_t num_funcs;
+  // The entries of the arrays ResultCU::types_begin and
+  // ResultFunc::types_begin index.
+  uint32_t num_cu_types;
+  uint32_t num_func_types;
+  uint32_t strings_size;
+  // Where each array starts in the file.
+  uint64_t cus_offset;
+  uint64_t types_offset;
+  uint64_t cu_types_offset;
+  uint64_t funcs_offset;
+  uint64_t func_types_offset;
+  uint64_t strings_offset;
+};
+
+// The functions of one CU are consecutive in their array. Its types are
+// cu_types[types_begin] to cu_types[types_begin + num_types - 1].
+struct ResultCU {
+  uint32_t types_begin;
+  uint32_t num_types;
+  uint32_t funcs_begin;
+  uint32_t num_funcs;
+};
+
+struct ResultType {
+  enum {
+    BASE, TYPEDEF, STRUCT
+  };
+
+  uint32_t name;
+  uint32_t kind;
+  // For BASE and STRUCT.
+  int32_t size;
+  // The name a TYPEDEF stands for, or 0.
+  uint32_t target;
+};
+
+struct ResultFunc {
+  uint32_t name;
+  // The names of the return type and then the parameter types are
+  // func_types[types_begin] to func_types[types_begin + num_types - 1].
+  uint32_t types_begin;
+  uint32_t num_types;
+};
+
+// Collects CUs and writes them as a result file in finish(). The tables
+// are kept in memory until then, with strings and types interned.
+class ResultWriter {
+public:
+  explicit ResultWriter(FILE* out);
+
+  void beginCU();
+  void addType(std::string_view name, uint32_t kind, int32_t size,
+               std::string_view target);
+  void addFunc(std::string_view name, const std::string_view* types,
+               size_t num_types);
+
+  void finish();
+
+private:
+  struct TypeHash {
+    size_t operator()(const ResultType& t) const {
+      size_t h = t.name;
+      h = h * 31 + t.kind;
+      h = h * 31 + (uint32_t)t.size;
+      return h * 31 + t.target;
+    }
+  };
+
+  struct TypeEqual {
+    bool operator()(const ResultType& a, const ResultType& b) const {
+      return (a.name == b.name && a.kind == b.kind && a.size == b.size &&
+              a.target == b.target);
+    }
+  };
+
+  uint32_t intern(std::string_view str);
+  void writeArray(const void* data, size_t size);
+
+  FILE* out_;
+  uint64_t pos_;
+  std::vector<ResultCU> cus_;
+  std::vector<ResultType> types_;
+  std::vector<uint32_t> cu_types_;
+  std::vector<ResultFunc> funcs_;
+  std::vector<uint32_t> func_types_;
+  std::string strings_;
+  std::unordered_map<std::string, uint32_t> string_ids_;
+  std::unordered_map<ResultType, uint32_t, TypeHash, TypeEqual> type_ids_;
+};
+
+// A mapped result file. Opening only checks the header: that the arrays
+// are within the file and that the string table is terminated, so it
+// takes the same time for any file. Records are checked as they are read,
+// and indices which point past their array throw CrefError.
+class ResultReader {
+public:
+  // Throws CrefError if |filename| is not a result file.
+  explicit ResultReader(const char* filename);
+  ~ResultReader();
+
+  uint32_t numCUs() const { return header_->num_cus; }
+
+  const ResultCU& cu(uint32_t i) const {
+    check(i < header_->num_cus);
+    return cus_[i];
+  }
+
+  const ResultType& type(uint32_t i) const {
+    check(i < header_->num_types);
+    return types_[i];
+  }
+
+  const ResultFunc& func(uint32_t i) const {
+    check(i < header_->num_funcs);
+    return funcs_[i];
+  }
+
+  // Type |i| of |cu|.
+  const ResultType& cuType(const ResultCU& cu, uint32_t i) const {
+    check((uint64_t)cu.types_begin + i < header_->num_cu_types);
+    return type(cu_types_[cu.types_begin + i]);
+  }
+
+  // The name of type |i| of |func|, where 0 is the return type.
+  const char* funcType(const ResultFunc& func, uint32_t i) const {
+    check((uint64_t)func.types_begin + i < header_->num_func_types);
+    return str(func_types_[func.types_begin + i]);
+  }
+
+  // Offsets past the string table give the empty string.
+  const char* str(uint32_t offset) const {
+    return offset < header_->strings_size ? strings_ + offset : strings_;
+  }
+
+private:
+  bool fits(uint64_t offset, uint64_t size) const;
+
+  void check(bool ok) const {
+    if (__builtin_expect(!ok, 0))
+      fail();
+  }
+  [[noreturn]] void fail() const;
+
+  std::string filename_;
+  void* mapped_;
+  size_t size_;
+  const ResultHeader* header_;
+  const ResultCU* cus_;
+  const ResultType* types_;
+  const uint32_t* cu_types_;
+  const ResultFunc* funcs_;
+  const uint32_t* func_types_;
+  const char* strings_;
+};
+
+#endif  // RESULT_FILE_H_
@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Runs the tests of `make check`. The binaries they read are built from
+# tests/*.c with the cc in $PATH.
+
+set -e
+
+tmp=$(mktemp -d)
+trap 'rm -rf $tmp' EXIT
+
+cc=${CC:-cc}
+$cc -g -gdwarf-4 -O0 -fPIC -shared -o $tmp/types.so tests/types.c
+$cc -g -gdwarf-4 -O0 -fPIC -shared -o $tmp/layout.so \
+  tests/layout_a.c tests/layout_b.c tests/layout_c.c
+
+# Fails unless the output of dump_debug_info with the arguments after the
+# first has the first in it.
+expect() {
+  want=$1
+  shift
+  out=$(./dump_debug_info "$@" 2>&1)
+  case $out in
+  *"$want"*)
+    echo "PASS $* has $want"
+    ;;
+  *)
+    echo "FAIL $* does not have $want"
+    echo "$out"
+    exit 1
+    ;;
+  esac
+}
+
+# Fails unless the output of dump_debug_info with the arguments after the
+# first two has the second in it as many times as the first says.
+expect_count() {
+  count=$1
+  want=$2
+  shift 2
+  got=$(./dump_debug_info "$@" | grep -cF "$want" || true)
+  if [ "$got" != "$count" ]; then
+    echo "FAIL $* has $want $got times instead of $count"
+    exit 1
+  fi
+  echo "PASS $* has $want $count times"
+}
+
+./corrupt_test $tmp/types.so $tmp/corrupt.so
+
+# Declarators keep typedef names and tag structs, unions and enums.
+for mode in "" --stream --lazy; do
+  expect '"point_t": ["typedef", "struct point"]' \
+    $mode --declarators $tmp/types.so
+  expect '"add_points": ["int", "point_t*", "const struct point*"]' \
+    $mode --declarators $tmp/types.so
+  expect '"get_value": ["double", "union value*", "enum color"]' \
+    $mode --declarators $tmp/types.so
+  expect '"sum": ["size_t", "const char*", "int (*)(const char*, size_t)"]' \
+    $mode --declarators $tmp/types.so
+done
+
+# Dedup keeps structs and enums with the same name and size but other
+# members apart.
+for mode in "" -j4 --stream --pipeline --lazy; do
+  expect_count 2 '"pair": ["struct", 16]' $mode --dedup $tmp/layout.so
+  expect_count 2 '"mode": ["struct", 4]' $mode --dedup $tmp/layout.so
+done
+
+echo "All tests passed"
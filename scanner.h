@@ -2,6 +2,14 @@
 #define SCANNER_H_
 
 #include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "abbrev.h"
+#include "die_batch.h"
+#include "util.h"
 
 class Binary;
 
@@ -12,20 +20,166 @@ struct CU {
   uint8_t ptrsize;
 } __attribute__((packed));
 
-class Scanner {
+// The parts of the scanner which do not depend on how DIEs are delivered.
+class ScannerBase {
 public:
-  explicit Scanner(Binary* binary);
+  explicit ScannerBase(Binary* binary);
+  ~ScannerBase();
+
+protected:
+  // Throws a CrefError.
+  template <class T>
+  [[noreturn]] static void bug(const char* fmt, T v) {
+    throwError(fmt, v);
+  }
+
+  // Rejects CU headers we cannot decode, including those of DWARF 5, whose
+  // fields are laid out differently, and those whose length runs past
+  // .debug_info, before their abbreviation offset is followed.
+  void checkCU(const CU* cu) const;
+
+  // A cheap pass over the CU headers to find where each CU starts. Their
+  // abbreviation tables are parsed here too, so that workers of
+  // runParallel() only read the cache.
+  void findCUs(std::vector<const uint8_t*>* cus,
+               std::vector<AbbrevTable>* tables);
+
+  // Steps over the children of a DIE, starting at |p| right after its
+  // attributes, and over the null entry that terminates them.
+  static const uint8_t* skipChildren(const uint8_t* p,
+                                     const uint8_t* attrs_p,
+                                     const Abbrev* abbrev,
+                                     const AbbrevTable& abbrevs,
+                                     const uint8_t* cu_start,
+                                     const uint8_t* cu_end);
+
+  // Returns the start of the CU which contains |offset|, or NULL. The CU
+  // headers are walked on the first call. Not for DWARF-zip binaries.
+  const uint8_t* findCUOf(uint64_t offset);
+
+  Binary* binary_;
+  AbbrevCache* abbrev_cache_;
+  // The .debug_info offsets of all CUs, for findCUOf().
+  std::vector<uint64_t> cu_offsets_;
+};
+
+// Scanner with compile-time dispatch. Derived must provide
+//
+//   void onCU(CU* cu, uint64_t offset);
+//   bool onAbbrev(uint16_t tag, uint64_t number, uint64_t offset);
+//   void onAbbrevDone();
+//   void onAttr(uint16_t name, uint8_t form,
+//               uint64_t value, uint64_t offset);
+//
+// and may hide wantsTag, wantsAttrs and wantsChildren. They are called
+// without virtual dispatch, so they can be inlined into the decoder loop.
+// If they are private, Derived should befriend StaticScanner<Derived>.
+template <class Derived>
+class StaticScanner : public ScannerBase {
+public:
+  explicit StaticScanner(Binary* binary)
+    : ScannerBase(binary) {
+  }
 
   void run();
 
+  // Decodes CUs on num_threads worker threads and replays them to the
+  // callbacks on the calling thread, in .debug_info order. DIEs whose tag is
+  // rejected by wantsTag() are only reported when they immediately precede
+  // a wanted DIE or end their CU. DWARF-zip binaries are always scanned
+  // sequentially because their CU boundaries are only known after
+  // decoding.
+  void runParallel(int num_threads);
+
+  // Like runParallel(), but hands the DIEs wanted by wantsTag() to
+  //
+  //   void onDIEs(const DIEBatch& batch);
+  //
+  // of Derived instead of onAbbrev, onAttr and onAbbrevDone, which Derived
+  // then need not provide. A batch never spans CUs and is only valid
+  // during the call.
+  void runBatched(int num_threads);
+
+  // Like runBatched(1), but CUs are decoded on a thread of their own while
+  // onDIEs() handles earlier ones on the calling thread. At most
+  // kPipelineDepth decoded CUs wait in between.
+  void runPipelined();
+
+  // Decodes the single DIE at |offset| into |batch|, replacing what it
+  // held, whatever wantsTag() says about it, and all DIEs below it if
+  // |with_children|. This is for following references out of the CU being
+  // scanned. Throws a CrefError for DWARF-zip binaries and for offsets
+  // outside .debug_info.
+  void readDIE(uint64_t offset, DIEBatch* batch, bool with_children = false);
+
+protected:
+  // Called from worker threads in runParallel(). onAbbrev must return false
+  // for tags rejected here.
+  bool wantsTag(uint16_t /*tag*/) const { return true; }
+  // Whether runBatched() and runPipelined() should decode the attributes
+  // of wanted DIEs with |tag|. The others are still handed to onDIEs(),
+  // without attributes, so that Derived knows where they are. Also called
+  // from worker threads.
+  bool wantsAttrs(uint16_t /*tag*/) const { return true; }
+  // Whether to scan the children of DIEs with |tag|. Skipped subtrees are
+  // not reported at all and are stepped over via DW_AT_sibling when it is
+  // present. Also called from worker threads.
+  bool wantsChildren(uint16_t /*tag*/) const { return true; }
+
+private:
+  static const size_t kPipelineDepth = 4;
+
+  class CallbackSink;
+  class CURecorder;
+  class BatchBuilder;
+  class DIEReader;
+
+  Derived* derived() { return static_cast<Derived*>(this); }
+  const Derived* derived() const { return static_cast<const Derived*>(this); }
+
+  // Decodes CUs into Recorders on worker threads and replays them in order.
+  // Workers stay at most num_threads * kPipelineDepth CUs ahead of the
+  // replay.
+  template <class Recorder>
+  void runRecorded(int num_threads);
+
+  template <class Sink>
+  const uint8_t* scanCU(const uint8_t* p, const AbbrevTable& abbrevs,
+                        Sink* sink);
+  template <int kPtrSize, int kOffsetSize, bool kZipped, class Sink>
+  const uint8_t* scanCUBody(const uint8_t* p, const AbbrevTable& abbrevs,
+                            Sink* sink);
+  template <int kPtrSize, int kOffsetSize, bool kZipped, class Sink>
+  const uint8_t* decodeAttrs(const uint8_t* p, const Abbrev* abbrev,
+                             const AbbrevTable& abbrevs, const CU* cu,
+                             bool will_care, Sink* sink);
+};
+
+// The callbacks of StaticScanner as virtual functions.
+class Scanner : public StaticScanner<Scanner> {
+public:
+  explicit Scanner(Binary* binary);
+  virtual ~Scanner();
+
 protected:
+  virtual bool wantsTag(uint16_t tag) const;
+  virtual bool wantsAttrs(uint16_t tag) const;
+  virtual bool wantsChildren(uint16_t tag) const;
+
   virtual void onCU(CU* cu, uint64_t offset) = 0;
   virtual bool onAbbrev(uint16_t tag, uint64_t number, uint64_t offset) = 0;
   virtual void onAbbrevDone() = 0;
   virtual void onAttr(uint16_t name, uint8_t form,
                       uint64_t value, uint64_t offset) = 0;
+  // Only called by runBatched(). Does nothing by default.
+  virtual void onDIEs(const DIEBatch& batch);
 
-  Binary* binary_;
+private:
+  friend class StaticScanner<Scanner>;
 };
 
+#include "scanner_impl.h"
+
+extern template class StaticScanner<Scanner>;
+
 #endif  // SCANNER_H_
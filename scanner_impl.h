@@ -0,0 +1,910 @@
+#ifndef SCANNER_IMPL_H_
+#define SCANNER_IMPL_H_
+
+// The templates of scanner.h. Include scanner.h instead of this.
+
+#include <dwarf.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "binary.h"
+#include "die_batch.h"
+#include "leb128.h"
+#include "spsc_queue.h"
+#include "thread_pool.h"
+#include "util.h"
+
+// Steps over the attributes of a DIE nobody is interested in, following
+// its precomputed skip plan.
+static inline const uint8_t* skipAttrs(const uint8_t* p,
+                                       const SkipStep* steps,
+                                       uint32_t num_steps) {
+  for (uint32_t i = 0; i < num_steps; i++) {
+    p += steps[i].fixed;
+    switch (steps[i].form) {
+    case 0:
+      break;
+
+    case DW_FORM_block1:
+      p += 1 + *p;
+      break;
+
+    case DW_FORM_block2:
+      p += 2 + *(uint16_t*)p;
+      break;
+
+    case DW_FORM_block4:
+      p += 4 + *(uint32_t*)p;
+      break;
+
+    case DW_FORM_block:
+    case DW_FORM_exprloc: {
+      uint64_t size = uleb128(p);
+      p += size;
+      break;
+    }
+
+    case DW_FORM_string:
+      p += strlen((char*)p) + 1;
+      break;
+
+    default:
+      // DW_FORM_sdata, DW_FORM_udata and the forms DWARF-zip stores as
+      // SLEB128. Only the end of the value matters here.
+      skipLEB128(p);
+    }
+  }
+  return p;
+}
+
+// Returns the DIE DW_AT_sibling points to, or NULL if the abbrev has no
+// usable one. |attrs_p| is where the attributes of the DIE start and |p|
+// is where they end.
+static inline const uint8_t* getSibling(const Abbrev* abbrev,
+                                        const uint8_t* attrs_p,
+                                        const uint8_t* p,
+                                        const uint8_t* cu_start,
+                                        const uint8_t* cu_end) {
+  if (abbrev->sibling_offset < 0)
+    return NULL;
+  const uint8_t* v = attrs_p + abbrev->sibling_offset;
+  uint64_t ref;
+  switch (abbrev->sibling_form) {
+  case DW_FORM_ref1:
+    ref = *v;
+    break;
+  case DW_FORM_ref2:
+    ref = *(uint16_t*)v;
+    break;
+  case DW_FORM_ref4:
+    ref = *(uint32_t*)v;
+    break;
+  case DW_FORM_ref8:
+    ref = *(uint64_t*)v;
+    break;
+  default:
+    return NULL;
+  }
+  if (ref < (uint64_t)(p - cu_start) || ref > (uint64_t)(cu_end - cu_start))
+    return NULL;
+  return cu_start + ref;
+}
+
+template <int N>
+static inline uint64_t readFixed(const uint8_t* p) {
+  return (N == 8 ? *(uint64_t*)p :
+          N == 4 ? *(uint32_t*)p :
+          N == 2 ? *(uint16_t*)p :
+          *p);
+}
+
+// Turns an attribute as the decoder reports it into an AttrValue.
+// |cu_offset| is where the CU of the DIE starts in .debug_info.
+static inline AttrValue makeAttrValue(uint16_t name, uint8_t form,
+                                      uint64_t value, uint64_t cu_offset,
+                                      const char* debug_str) {
+  AttrValue attr;
+  attr.name = name;
+  attr.form = form;
+  attr.value = value;
+  attr.data = NULL;
+  switch (form) {
+  case DW_FORM_addr:
+    attr.kind = AttrValue::ADDRESS;
+    break;
+
+  case DW_FORM_ref_addr:
+    attr.kind = AttrValue::REFERENCE;
+    break;
+
+  case DW_FORM_ref1:
+  case DW_FORM_ref2:
+  case DW_FORM_ref4:
+  case DW_FORM_ref8:
+    attr.kind = AttrValue::REFERENCE;
+    attr.value += cu_offset;
+    break;
+
+  case DW_FORM_sec_offset:
+    attr.kind = AttrValue::SEC_OFFSET;
+    break;
+
+  case DW_FORM_flag:
+    attr.kind = AttrValue::FLAG;
+    break;
+
+  case DW_FORM_flag_present:
+    attr.kind = AttrValue::FLAG;
+    attr.value = 1;
+    break;
+
+  case DW_FORM_strp:
+    attr.kind = AttrValue::STRING;
+    attr.data = debug_str + value;
+    attr.value = 0;
+    break;
+
+  case DW_FORM_string:
+    attr.kind = AttrValue::STRING;
+    attr.data = (const char*)value;
+    attr.value = 0;
+    break;
+
+  case DW_FORM_block1:
+  case DW_FORM_block2:
+  case DW_FORM_block4:
+  case DW_FORM_block:
+  case DW_FORM_exprloc: {
+    // The decoder passes where the size of the block starts.
+    const uint8_t* p = (const uint8_t*)value;
+    attr.kind = AttrValue::BLOCK;
+    switch (form) {
+    case DW_FORM_block1:
+      attr.value = *p++;
+      break;
+    case DW_FORM_block2:
+      attr.value = *(uint16_t*)p;
+      p += 2;
+      break;
+    case DW_FORM_block4:
+      attr.value = *(uint32_t*)p;
+      p += 4;
+      break;
+    default:
+      attr.value = uleb128(p);
+    }
+    attr.data = (const char*)p;
+    break;
+  }
+
+  default:
+    attr.kind = AttrValue::CONSTANT;
+  }
+  return attr;
+}
+
+// Forwards DIEs to the callbacks of the scanner as they are decoded.
+template <class Derived>
+class StaticScanner<Derived>::CallbackSink {
+public:
+  explicit CallbackSink(Derived* scanner)
+    : scanner_(scanner) {
+  }
+
+  bool onDIE(const Abbrev* abbrev, uint64_t number, uint64_t offset,
+             int /*depth*/, uint16_t /*prev_tag*/) {
+    return scanner_->onAbbrev(abbrev->tag, number, offset);
+  }
+
+  void onAttr(uint16_t name, uint8_t form, uint64_t value, uint64_t offset) {
+    scanner_->onAttr(name, form, value, offset);
+  }
+
+  void onDIEDone() {
+    scanner_->onAbbrevDone();
+  }
+
+private:
+  Derived* scanner_;
+};
+
+// Records the DIEs of one CU for the callbacks, to replay them later on
+// another thread.
+template <class Derived>
+class StaticScanner<Derived>::CURecorder {
+public:
+  CURecorder(const Derived* scanner, const uint8_t* /*cu_start*/)
+    : scanner_(scanner),
+      has_pending_(false) {
+  }
+
+  bool onDIE(const Abbrev* abbrev, uint64_t number, uint64_t offset,
+             int /*depth*/, uint16_t /*prev_tag*/) {
+    uint16_t tag = abbrev->tag;
+    DIE die;
+    die.tag = tag;
+    die.number = number;
+    die.offset = offset;
+    die.attr_end = attrs_.size();
+    if (!scanner_->wantsTag(tag)) {
+      pending_ = die;
+      has_pending_ = true;
+      return false;
+    }
+    if (has_pending_) {
+      dies_.push_back(pending_);
+      has_pending_ = false;
+    }
+    dies_.push_back(die);
+    return true;
+  }
+
+  void onDIEDone() {
+    dies_.back().attr_end = attrs_.size();
+  }
+
+  void onAttr(uint16_t name, uint8_t form, uint64_t value, uint64_t offset) {
+    RawAttr attr;
+    attr.name = name;
+    attr.form = form;
+    attr.value = value;
+    attr.offset = offset;
+    attrs_.push_back(attr);
+  }
+
+  void finish() {
+    if (has_pending_) {
+      dies_.push_back(pending_);
+      has_pending_ = false;
+    }
+  }
+
+  void replay(Derived* scanner) const {
+    size_t attr_begin = 0;
+    for (size_t i = 0; i < dies_.size(); i++) {
+      const DIE& die = dies_[i];
+      bool will_care = scanner->onAbbrev(die.tag, die.number, die.offset);
+      if (will_care) {
+        for (size_t j = attr_begin; j < die.attr_end; j++) {
+          const RawAttr& attr = attrs_[j];
+          scanner->onAttr(attr.name, attr.form, attr.value, attr.offset);
+        }
+        scanner->onAbbrevDone();
+      }
+      attr_begin = die.attr_end;
+    }
+  }
+
+private:
+  struct DIE {
+    uint64_t number;
+    uint64_t offset;
+    size_t attr_end;
+    uint16_t tag;
+  };
+
+  struct RawAttr {
+    uint64_t value;
+    uint64_t offset;
+    uint16_t name;
+    uint8_t form;
+  };
+
+  const Derived* scanner_;
+  std::vector<DIE> dies_;
+  std::vector<RawAttr> attrs_;
+  DIE pending_;
+  bool has_pending_;
+};
+
+// Turns the wanted DIEs of one CU into DIEBatches.
+template <class Derived>
+class StaticScanner<Derived>::BatchBuilder {
+public:
+  BatchBuilder(const Derived* scanner, const uint8_t* cu_start)
+    : scanner_(scanner),
+      cu_offset_(cu_start - (const uint8_t*)scanner->binary_->debug_info),
+      debug_str_(scanner->binary_->debug_str),
+      num_batches_(0) {
+  }
+
+  ~BatchBuilder() {
+    for (size_t i = 0; i < batches_.size(); i++)
+      delete batches_[i];
+  }
+
+  bool onDIE(const Abbrev* abbrev, uint64_t /*number*/, uint64_t offset,
+             int depth, uint16_t prev_tag) {
+    if (!scanner_->wantsTag(abbrev->tag))
+      return false;
+    if (!num_batches_ || batches_[num_batches_ - 1]->full()) {
+      if (num_batches_ == batches_.size())
+        batches_.push_back(new DIEBatch);
+      num_batches_++;
+    }
+    DIERecord* die = batches_[num_batches_ - 1]->addDIE();
+    die->offset = offset;
+    die->tag = abbrev->tag;
+    die->prev_tag = prev_tag;
+    die->depth = depth;
+    die->has_children = abbrev->has_children;
+    return scanner_->wantsAttrs(abbrev->tag);
+  }
+
+  void onAttr(uint16_t name, uint8_t form, uint64_t value,
+              uint64_t /*offset*/) {
+    batches_[num_batches_ - 1]->addAttr(
+        makeAttrValue(name, form, value, cu_offset_, debug_str_));
+  }
+
+  void onDIEDone() {
+  }
+
+  void finish() {
+    for (size_t i = 0; i < num_batches_; i++)
+      batches_[i]->seal();
+  }
+
+  void replay(Derived* scanner) const {
+    for (size_t i = 0; i < num_batches_; i++)
+      scanner->onDIEs(*batches_[i]);
+  }
+
+  // Lets the batches be used for another CU.
+  void reset(const uint8_t* cu_start) {
+    for (size_t i = 0; i < num_batches_; i++)
+      batches_[i]->clear();
+    num_batches_ = 0;
+    cu_offset_ = cu_start - (const uint8_t*)scanner_->binary_->debug_info;
+  }
+
+private:
+  const Derived* scanner_;
+  uint64_t cu_offset_;
+  const char* debug_str_;
+  std::vector<DIEBatch*> batches_;
+  size_t num_batches_;
+};
+
+// Decodes one DIE into a DIEBatch for readDIE().
+template <class Derived>
+class StaticScanner<Derived>::DIEReader {
+public:
+  DIEReader(const Derived* scanner, const uint8_t* cu_start, DIEBatch* batch)
+    : cu_offset_(cu_start - (const uint8_t*)scanner->binary_->debug_info),
+      debug_str_(scanner->binary_->debug_str),
+      batch_(batch) {
+  }
+
+  bool onDIE(const Abbrev* abbrev, uint64_t /*number*/, uint64_t offset,
+             int depth, uint16_t prev_tag) {
+    DIERecord* die = batch_->addDIE();
+    die->offset = offset;
+    die->tag = abbrev->tag;
+    die->prev_tag = prev_tag;
+    die->depth = depth;
+    die->has_children = abbrev->has_children;
+    return true;
+  }
+
+  void onAttr(uint16_t name, uint8_t form, uint64_t value,
+              uint64_t /*offset*/) {
+    batch_->addAttr(makeAttrValue(name, form, value, cu_offset_, debug_str_));
+  }
+
+  void onDIEDone() {
+  }
+
+private:
+  uint64_t cu_offset_;
+  const char* debug_str_;
+  DIEBatch* batch_;
+};
+
+// Picks the decoder specialized for the layout of the CU at |p|, so the
+// address size and DWARF-zip checks happen once per CU instead of once per
+// attribute.
+template <class Derived>
+template <class Sink>
+const uint8_t* StaticScanner<Derived>::scanCU(const uint8_t* p,
+                                              const AbbrevTable& abbrevs,
+                                              Sink* sink) {
+  // 64-bit DWARF is rejected by checkCU, so offsets are 4 bytes.
+  const uint8_t ptrsize = ((CU*)p)->ptrsize;
+  if (binary_->is_zipped) {
+    switch (ptrsize) {
+    case 8:
+      return scanCUBody<8, 4, true>(p, abbrevs, sink);
+    case 4:
+      return scanCUBody<4, 4, true>(p, abbrevs, sink);
+    case 2:
+      return scanCUBody<2, 4, true>(p, abbrevs, sink);
+    default:
+      // Only works as long as no address shows up.
+      return scanCUBody<0, 4, true>(p, abbrevs, sink);
+    }
+  } else {
+    switch (ptrsize) {
+    case 8:
+      return scanCUBody<8, 4, false>(p, abbrevs, sink);
+    case 4:
+      return scanCUBody<4, 4, false>(p, abbrevs, sink);
+    case 2:
+      return scanCUBody<2, 4, false>(p, abbrevs, sink);
+    default:
+      return scanCUBody<0, 4, false>(p, abbrevs, sink);
+    }
+  }
+}
+
+template <class Derived>
+template <int kPtrSize, int kOffsetSize, bool kZipped, class Sink>
+const uint8_t* StaticScanner<Derived>::scanCUBody(const uint8_t* p,
+                                                  const AbbrevTable& abbrevs,
+                                                  Sink* sink) {
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+
+  CU* cu = (CU*)p;
+  const uint8_t* cu_start = p;
+  const uint8_t* cu_end = p + cu->length + 4;
+  p += sizeof(CU);
+
+  int depth = 0;
+  uint16_t prev_tag = 0;
+
+  while (p < cu_end) {
+    const uint8_t* abb_p = p;
+    uint64_t abbrev_number = uleb128(p);
+    //printf("abbrev_number: %d\n", (int)abbrev_number);
+    if (abbrev_number == 0) {
+      depth--;
+      if (depth == 0)
+        break;
+      continue;
+    }
+
+    if (p >= cu_end)
+      bug("Truncated DIE at %" PRIx64, (uint64_t)(abb_p - dinfo_start));
+
+    const Abbrev* abbrev = abbrevs.find(abbrev_number);
+    if (!abbrev)
+      bug("Unknown abbrev number: %" PRIu64, abbrev_number);
+    int die_depth = depth;
+    bool skip_children =
+      abbrev->has_children && !derived()->wantsChildren(abbrev->tag);
+    if (abbrev->has_children && !skip_children)
+      depth++;
+
+    bool will_care = sink->onDIE(abbrev, abbrev_number, abb_p - dinfo_start,
+                                 die_depth, prev_tag);
+    prev_tag = abbrev->tag;
+    const uint8_t* attrs_p = p;
+    if (!will_care && abbrev->can_skip) {
+      p = skipAttrs(p, abbrevs.getSkips(abbrev), abbrev->num_skips);
+      if (skip_children)
+        p = skipChildren(p, attrs_p, abbrev, abbrevs, cu_start, cu_end);
+      continue;
+    }
+
+    p = decodeAttrs<kPtrSize, kOffsetSize, kZipped>(p, abbrev, abbrevs, cu,
+                                                    will_care, sink);
+    if (will_care)
+      sink->onDIEDone();
+    if (skip_children)
+      p = skipChildren(p, attrs_p, abbrev, abbrevs, cu_start, cu_end);
+  }
+
+  if (!kZipped && p != cu_end)
+    bug("CU at %" PRIx64 " does not end at its length",
+        (uint64_t)(cu_start - dinfo_start));
+  return p;
+}
+
+// Decodes the attributes of one DIE starting at |p|, and reports them to
+// |sink| if |will_care|.
+template <class Derived>
+template <int kPtrSize, int kOffsetSize, bool kZipped, class Sink>
+const uint8_t* StaticScanner<Derived>::decodeAttrs(const uint8_t* p,
+                                                   const Abbrev* abbrev,
+                                                   const AbbrevTable& abbrevs,
+                                                   const CU* cu,
+                                                   bool will_care,
+                                                   Sink* sink) {
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+
+  const Attr* attrs = abbrevs.getAttrs(abbrev);
+  for (uint32_t i = 0; i < abbrev->num_attrs; i++) {
+    const uint8_t* attr_p = p;
+    const Attr attr = attrs[i];
+    uint64_t value = 0xffffffffffffffff;
+    //printf("name=%x form=%x\n", attr.name, attr.form);
+
+    switch (attr.form) {
+    case DW_FORM_ref_addr:
+      if (getRefAddrSize(cu->version, cu->ptrsize) != cu->ptrsize) {
+        if (kZipped) {
+          value = sleb128(p);
+        } else {
+          value = readFixed<kOffsetSize>(p);
+          p += kOffsetSize;
+        }
+        break;
+      }
+      // Fall through.
+    case DW_FORM_addr:
+      if (kZipped && kPtrSize == 8) {
+        value = sleb128(p);
+      } else if (kPtrSize == 0) {
+        bug("Unknown ptrsize: %d", cu->ptrsize);
+      } else {
+        value = readFixed<kPtrSize>(p);
+        p += kPtrSize;
+      }
+      break;
+
+    case DW_FORM_block1: {
+      value = (uint64_t)p;
+      uint8_t size = *p++;
+      p += size;
+      break;
+    }
+
+    case DW_FORM_block2: {
+      value = (uint64_t)p;
+      uint16_t size = *(uint16_t*)p;
+      p += 2;
+      p += size;
+      break;
+    }
+
+    case DW_FORM_block4: {
+      value = (uint64_t)p;
+      uint32_t size = *(uint32_t*)p;
+      p += 4;
+      p += size;
+      break;
+    }
+
+    case DW_FORM_block:
+    case DW_FORM_exprloc: {
+      value = (uint64_t)p;
+      uint64_t size = uleb128(p);
+      p += size;
+      break;
+    }
+
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+      value = *p++;
+      break;
+
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+      value = *(uint16_t*)p;
+      p += 2;
+      break;
+
+    case DW_FORM_strp:
+    case DW_FORM_sec_offset:
+      if (kZipped) {
+        value = sleb128(p);
+      } else {
+        value = readFixed<kOffsetSize>(p);
+        p += kOffsetSize;
+      }
+      // Binary makes sure .debug_str ends with a NUL.
+      if (attr.form == DW_FORM_strp && value >= binary_->debug_str_len)
+        bug("strp out of .debug_str: %" PRIx64, value);
+      break;
+
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+      if (kZipped) {
+        value = sleb128(p);
+      } else {
+        value = *(uint32_t*)p;
+        p += 4;
+      }
+      break;
+
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+      value = *(uint64_t*)p;
+      p += 8;
+      break;
+
+    case DW_FORM_string:
+      value = (uint64_t)p;
+      p += strlen((char*)p) + 1;
+      break;
+
+    case DW_FORM_sdata:
+      value = (uint64_t)sleb128(p);
+      break;
+
+    case DW_FORM_udata:
+      value = (uint64_t)uleb128(p);
+      break;
+
+    case DW_FORM_flag_present:
+      break;
+
+    case DW_FORM_ref_udata:
+    case DW_FORM_indirect:
+    case DW_FORM_ref_sig8:
+
+    default:
+      bug("Unknown DW_FORM: %x", attr.form);
+    }
+
+    if (will_care)
+      sink->onAttr(attr.name, attr.form, value, attr_p - dinfo_start);
+  }
+  return p;
+}
+
+template <class Derived>
+void StaticScanner<Derived>::run() {
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+  const uint8_t* dinfo_end = dinfo_start + binary_->debug_info_len;
+  const uint8_t* p = dinfo_start;
+
+  while (p + sizeof(CU) < dinfo_end) {
+    CU* cu = (CU*)p;
+    checkCU(cu);
+    derived()->onCU(cu, p - dinfo_start);
+    CallbackSink sink(derived());
+    AbbrevTable abbrevs =
+      abbrev_cache_->get(cu->abbrev_offset, cu->ptrsize, cu->version);
+    p = scanCU(p, abbrevs, &sink);
+  }
+
+  if (p != dinfo_end)
+    bug("Garbage at .debug_info offset %" PRIx64,
+        (uint64_t)(p - dinfo_start));
+}
+
+template <class Derived>
+void StaticScanner<Derived>::runParallel(int num_threads) {
+  if (num_threads <= 1 || binary_->is_zipped) {
+    run();
+    return;
+  }
+  runRecorded<CURecorder>(num_threads);
+}
+
+template <class Derived>
+void StaticScanner<Derived>::runBatched(int num_threads) {
+  if (num_threads > 1 && !binary_->is_zipped) {
+    runRecorded<BatchBuilder>(num_threads);
+    return;
+  }
+
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+  const uint8_t* dinfo_end = dinfo_start + binary_->debug_info_len;
+  const uint8_t* p = dinfo_start;
+
+  BatchBuilder builder(derived(), p);
+  while (p + sizeof(CU) < dinfo_end) {
+    CU* cu = (CU*)p;
+    checkCU(cu);
+    derived()->onCU(cu, p - dinfo_start);
+    builder.reset(p);
+    AbbrevTable abbrevs =
+      abbrev_cache_->get(cu->abbrev_offset, cu->ptrsize, cu->version);
+    p = scanCU(p, abbrevs, &builder);
+    builder.finish();
+    builder.replay(derived());
+  }
+
+  if (p != dinfo_end)
+    bug("Garbage at .debug_info offset %" PRIx64,
+        (uint64_t)(p - dinfo_start));
+}
+
+template <class Derived>
+template <class Recorder>
+void StaticScanner<Derived>::runRecorded(int num_threads) {
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+
+  std::vector<const uint8_t*> cus;
+  std::vector<AbbrevTable> tables;
+  findCUs(&cus, &tables);
+
+  // A CU is done once it has either a result or an error.
+  std::vector<std::unique_ptr<Recorder> > results(cus.size());
+  std::vector<std::exception_ptr> errors(cus.size());
+  std::mutex mu;
+  std::condition_variable cond;
+  // Lets the workers skip the rest once the replay has given up.
+  std::atomic<bool> failed(false);
+  // Workers only decode CU i once i < next_replayed + window, so that at
+  // most |window| recorded CUs wait for the replay at a time.
+  size_t next_replayed = 0;
+  const size_t window = num_threads * kPipelineDepth;
+
+  WorkStealingPool pool(num_threads, cus.size(), [&](size_t i) {
+    {
+      std::unique_lock<std::mutex> lock(mu);
+      while (i >= next_replayed + window && !failed)
+        cond.wait(lock);
+    }
+    std::unique_ptr<Recorder> recorder;
+    std::exception_ptr error;
+    if (failed) {
+      error = std::make_exception_ptr(CrefError("cancelled"));
+    } else {
+      try {
+        recorder.reset(new Recorder(derived(), cus[i]));
+        scanCU(cus[i], tables[i], recorder.get());
+        recorder->finish();
+      } catch (...) {
+        recorder.reset();
+        error = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> lock(mu);
+    results[i] = std::move(recorder);
+    errors[i] = error;
+    cond.notify_all();
+  });
+
+  for (size_t i = 0; i < cus.size(); i++) {
+    std::unique_ptr<Recorder> recorder;
+    {
+      std::unique_lock<std::mutex> lock(mu);
+      while (!results[i] && !errors[i])
+        cond.wait(lock);
+      recorder = std::move(results[i]);
+      if (errors[i]) {
+        failed = true;
+        cond.notify_all();
+        std::rethrow_exception(errors[i]);
+      }
+    }
+    try {
+      derived()->onCU((CU*)cus[i], cus[i] - dinfo_start);
+      recorder->replay(derived());
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mu);
+      failed = true;
+      cond.notify_all();
+      throw;
+    }
+    recorder.reset();
+    std::lock_guard<std::mutex> lock(mu);
+    next_replayed = i + 1;
+    cond.notify_all();
+  }
+}
+
+// Builders go back to the decoder through a second queue to be reused.
+template <class Derived>
+void StaticScanner<Derived>::runPipelined() {
+  if (binary_->is_zipped) {
+    runBatched(1);
+    return;
+  }
+
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+
+  std::vector<const uint8_t*> cus;
+  std::vector<AbbrevTable> tables;
+  findCUs(&cus, &tables);
+
+  // A decoded CU, or the error which stopped the decoder.
+  struct Decoded {
+    std::unique_ptr<BatchBuilder> builder;
+    std::exception_ptr error;
+  };
+  SPSCQueue<Decoded> decoded(kPipelineDepth);
+  SPSCQueue<std::unique_ptr<BatchBuilder> > done(kPipelineDepth + 2);
+
+  std::thread decoder([&]() {
+    for (size_t i = 0; i < cus.size(); i++) {
+      Decoded cu;
+      try {
+        if (done.tryPop(&cu.builder))
+          cu.builder->reset(cus[i]);
+        else
+          cu.builder.reset(new BatchBuilder(derived(), cus[i]));
+        scanCU(cus[i], tables[i], cu.builder.get());
+        cu.builder->finish();
+      } catch (...) {
+        cu.builder.reset();
+        cu.error = std::current_exception();
+      }
+      bool failed = cu.error != NULL;
+      if (!decoded.push(std::move(cu)) || failed)
+        break;
+    }
+    decoded.close();
+  });
+
+  try {
+    for (size_t i = 0; i < cus.size(); i++) {
+      Decoded cu;
+      if (!decoded.pop(&cu))
+        bug("Decoder stopped at CU %zu", i);
+      if (cu.error)
+        std::rethrow_exception(cu.error);
+      derived()->onCU((CU*)cus[i], cus[i] - dinfo_start);
+      cu.builder->replay(derived());
+      done.tryPush(&cu.builder);
+    }
+  } catch (...) {
+    decoded.close();
+    decoder.join();
+    throw;
+  }
+  decoder.join();
+}
+
+// The DIE does not know its depth or the tag before it, so they are 0.
+template <class Derived>
+void StaticScanner<Derived>::readDIE(uint64_t offset, DIEBatch* batch,
+                                     bool with_children) {
+  if (binary_->is_zipped)
+    bug("Cannot read a single DIE of DWARF-zip: %" PRIx64, offset);
+  const uint8_t* cu_start = findCUOf(offset);
+  if (!cu_start)
+    bug("No CU contains DIE at %" PRIx64, offset);
+  const uint8_t* dinfo_start = (const uint8_t*)binary_->debug_info;
+  CU* cu = (CU*)cu_start;
+  const uint8_t* cu_end = cu_start + cu->length + 4;
+  AbbrevTable abbrevs =
+    abbrev_cache_->get(cu->abbrev_offset, cu->ptrsize, cu->version);
+
+  batch->clear();
+  DIEReader reader(derived(), cu_start, batch);
+  const uint8_t* p = dinfo_start + offset;
+  int depth = 0;
+  uint16_t prev_tag = 0;
+  for (;;) {
+    const uint8_t* die_p = p;
+    uint64_t number = uleb128(p);
+    if (p >= cu_end)
+      bug("Truncated DIE at %" PRIx64, (uint64_t)(die_p - dinfo_start));
+    const Abbrev* abbrev = abbrevs.find(number);
+    if (!abbrev)
+      bug("Unknown abbrev number: %" PRIu64, number);
+
+    reader.onDIE(abbrev, number, die_p - dinfo_start, depth, prev_tag);
+    switch (cu->ptrsize) {
+    case 8:
+      p = decodeAttrs<8, 4, false>(p, abbrev, abbrevs, cu, true, &reader);
+      break;
+    case 4:
+      p = decodeAttrs<4, 4, false>(p, abbrev, abbrevs, cu, true, &reader);
+      break;
+    case 2:
+      p = decodeAttrs<2, 4, false>(p, abbrev, abbrevs, cu, true, &reader);
+      break;
+    default:
+      p = decodeAttrs<0, 4, false>(p, abbrev, abbrevs, cu, true, &reader);
+    }
+    prev_tag = abbrev->tag;
+    if (!with_children)
+      break;
+    if (abbrev->has_children)
+      depth++;
+    // A null entry ends the children of a DIE.
+    while (depth && p < cu_end && !*p) {
+      p++;
+      depth--;
+    }
+    if (!depth)
+      break;
+  }
+  batch->seal();
+}
+
+#endif  // SCANNER_IMPL_H_
@@ -0,0 +1,88 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// A bounded queue from one producer thread to one consumer thread which
+// takes no locks. The ends wait by yielding, which suits pipeline stages
+// that are meant to keep a core each busy anyway.
+//
+// Either end may close() the queue. The producer then cannot push any
+// more, and the consumer gets what was pushed before and then nothing.
+template <class T>
+class SPSCQueue {
+public:
+  explicit SPSCQueue(size_t capacity)
+    : slots_(capacity + 1),
+      head_(0),
+      tail_(0),
+      closed_(false) {
+  }
+
+  // Returns false without waiting if the queue is full or closed.
+  bool tryPush(T* value) {
+    if (closed_.load(std::memory_order_acquire))
+      return false;
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+    if (next == head_.load(std::memory_order_acquire))
+      return false;
+    slots_[tail] = std::move(*value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Waits while the queue is full. Returns false if it is closed.
+  bool push(T value) {
+    while (!tryPush(&value)) {
+      if (closed_.load(std::memory_order_acquire))
+        return false;
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  // Returns false without waiting if the queue is empty.
+  bool tryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = std::move(slots_[head]);
+    head_.store(head + 1 == slots_.size() ? 0 : head + 1,
+                std::memory_order_release);
+    return true;
+  }
+
+  // Waits while the queue is empty. Returns false once it is closed and
+  // drained.
+  bool pop(T* value) {
+    while (!tryPop(value)) {
+      // Check tail_ again after seeing closed_, as the last push may have
+      // landed in between.
+      if (closed_.load(std::memory_order_acquire))
+        return tryPop(value);
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  void close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+private:
+  // One slot is always left empty to tell a full queue from an empty one.
+  std::vector<T> slots_;
+  // Keep the ends on their own cache lines, as each is written by a
+  // different thread.
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+  alignas(64) std::atomic<bool> closed_;
+};
+
+#endif  // SPSC_QUEUE_H_
@@ -0,0 +1,63 @@
+#ifndef STRING_POOL_H_
+#define STRING_POOL_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Keeps one copy of each string added to it. The copies are never moved,
+// so the views intern() returns stay valid as long as the pool, and may be
+// read from other threads once they are handed over.
+class StringPool {
+public:
+  StringPool()
+    : current_(NULL),
+      used_(kBlockSize) {
+  }
+
+  StringPool(const StringPool&) = delete;
+  StringPool& operator=(const StringPool&) = delete;
+
+  std::string_view intern(std::string_view s) {
+    if (s.empty())
+      return std::string_view("", 0);
+    std::unordered_set<std::string_view>::const_iterator found =
+      strings_.find(s);
+    if (found != strings_.end())
+      return *found;
+    std::string_view copy(allocate(s.size()), s.size());
+    memcpy((char*)copy.data(), s.data(), s.size());
+    strings_.insert(copy);
+    return copy;
+  }
+
+private:
+  static const size_t kBlockSize = 1 << 16;
+
+  // Strings longer than a block get one of their own.
+  char* allocate(size_t size) {
+    if (size > kBlockSize) {
+      blocks_.emplace_back(new char[size]);
+      return blocks_.back().get();
+    }
+    if (size > kBlockSize - used_) {
+      blocks_.emplace_back(new char[kBlockSize]);
+      used_ = 0;
+      current_ = blocks_.back().get();
+    }
+    char* p = current_ + used_;
+    used_ += size;
+    return p;
+  }
+
+  std::vector<std::unique_ptr<char[]> > blocks_;
+  char* current_;
+  size_t used_;
+  std::unordered_set<std::string_view> strings_;
+};
+
+#endif  // STRING_POOL_H_
@@ -0,0 +1,11 @@
+struct pair {
+  int first;
+  int second;
+  struct pair* next;
+};
+
+enum mode { MODE_READ, MODE_WRITE };
+
+int pair_a(struct pair* p, enum mode m) {
+  return p->first + p->second + m;
+}
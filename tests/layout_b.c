@@ -0,0 +1,13 @@
+/* The same names and sizes as in layout_a.c, but other members. */
+
+struct pair {
+  int x;
+  int y;
+  struct pair* next;
+};
+
+enum mode { MODE_READ = 1, MODE_WRITE = 0 };
+
+int pair_b(struct pair* p, enum mode m) {
+  return p->x + p->y + m;
+}
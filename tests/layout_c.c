@@ -0,0 +1,13 @@
+/* The same types as in layout_a.c. */
+
+struct pair {
+  int first;
+  int second;
+  struct pair* next;
+};
+
+enum mode { MODE_READ, MODE_WRITE };
+
+int pair_c(struct pair* p, enum mode m) {
+  return p->first - p->second - m;
+}
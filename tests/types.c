@@ -0,0 +1,27 @@
+#include <stddef.h>
+
+struct point {
+  int x;
+  int y;
+};
+
+typedef struct point point_t;
+
+union value {
+  long l;
+  double d;
+};
+
+enum color { RED, GREEN, BLUE };
+
+int add_points(point_t* a, const struct point* b) {
+  return a->x + b->x + a->y + b->y;
+}
+
+double get_value(union value* v, enum color c) {
+  return c == RED ? v->l : v->d;
+}
+
+size_t sum(const char* s, int (*f)(const char*, size_t)) {
+  return f(s, 0);
+}
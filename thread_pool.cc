@@ -0,0 +1,56 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(int num_threads, size_t num_tasks,
+                                   const function<void(size_t)>& task)
+  : task_(task) {
+  if (num_threads < 1)
+    num_threads = 1;
+  for (int i = 0; i < num_threads; i++)
+    workers_.push_back(new Worker);
+  for (size_t i = 0; i < num_tasks; i++)
+    workers_[i % workers_.size()]->tasks.push_back(i);
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i]->thread = thread(&WorkStealingPool::work, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  // Other workers may still be probing a finished worker's queue, so only
+  // free them once everybody has stopped.
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i]->thread.join();
+  for (size_t i = 0; i < workers_.size(); i++)
+    delete workers_[i];
+}
+
+void WorkStealingPool::work(size_t id) {
+  size_t task;
+  while (take(id, &task))
+    task_(task);
+}
+
+bool WorkStealingPool::take(size_t id, size_t* task) {
+  {
+    Worker* self = workers_[id];
+    lock_guard<mutex> lock(self->mu);
+    if (!self->tasks.empty()) {
+      *task = self->tasks.front();
+      self->tasks.pop_front();
+      return true;
+    }
+  }
+
+  // No task is added after construction, so a full round of empty victims
+  // means everything has been handed out.
+  for (size_t i = 1; i < workers_.size(); i++) {
+    Worker* victim = workers_[(id + i) % workers_.size()];
+    lock_guard<mutex> lock(victim->mu);
+    if (!victim->tasks.empty()) {
+      *task = victim->tasks.back();
+      victim->tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,39 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs task(0), ..., task(num_tasks - 1) on num_threads workers.
+//
+// Task i is initially queued on worker i % num_threads, so tasks complete
+// roughly in index order. A worker pops from the front of its own queue and,
+// once that is empty, steals from the back of another worker's queue. This
+// keeps all workers busy even when task costs differ by orders of magnitude.
+class WorkStealingPool {
+public:
+  WorkStealingPool(int num_threads, size_t num_tasks,
+                   const std::function<void(size_t)>& task);
+  // Waits for all tasks to finish.
+  ~WorkStealingPool();
+
+private:
+  struct Worker {
+    std::mutex mu;
+    std::deque<size_t> tasks;
+    std::thread thread;
+  };
+
+  void work(size_t id);
+  bool take(size_t id, size_t* task);
+
+  std::function<void(size_t)> task_;
+  std::vector<Worker*> workers_;
+};
+
+#endif  // THREAD_POOL_H_
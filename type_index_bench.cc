@@ -0,0 +1,142 @@
+// Measures how fast the dumper can index type DIEs by offset, comparing
+// OffsetIndex with the std::map it used before. The offsets of type DIEs
+// and the DW_AT_type references to look up are taken from a real binary,
+// such as a libc with debug info.
+//
+// Usage: ./type_index_bench binary
+
+#include <dwarf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "binary.h"
+#include "offset_index.h"
+#include "scanner.h"
+#include "util.h"
+
+using namespace std;
+
+class TypeRefCollector : public StaticScanner<TypeRefCollector> {
+public:
+  explicit TypeRefCollector(Binary* binary)
+    : StaticScanner<TypeRefCollector>(binary) {
+  }
+
+  vector<uint64_t> types;
+  vector<uint64_t> refs;
+
+private:
+  friend class StaticScanner<TypeRefCollector>;
+
+  void onCU(CU* /*cu*/, uint64_t /*offset*/) {
+  }
+
+  // The DIEs the dumper keeps in its index.
+  static bool isType(uint16_t tag) {
+    return (tag == DW_TAG_base_type ||
+            tag == DW_TAG_typedef ||
+            tag == DW_TAG_structure_type ||
+            tag == DW_TAG_union_type ||
+            tag == DW_TAG_enumeration_type ||
+            tag == DW_TAG_pointer_type ||
+            tag == DW_TAG_array_type ||
+            tag == DW_TAG_const_type ||
+            tag == DW_TAG_volatile_type ||
+            tag == DW_TAG_subroutine_type);
+  }
+
+  void onDIEs(const DIEBatch& batch) {
+    for (size_t i = 0; i < batch.size(); i++) {
+      const DIERecord& die = batch[i];
+      if (isType(die.tag))
+        types.push_back(die.offset);
+      const AttrValue* type = die.find(DW_AT_type);
+      if (type && type->kind == AttrValue::REFERENCE)
+        refs.push_back(type->value);
+    }
+  }
+};
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s binary\n", argv[0]);
+    exit(1);
+  }
+
+  unique_ptr<Binary> binary;
+  unique_ptr<TypeRefCollector> collector;
+  try {
+    binary.reset(readBinary(argv[1]));
+    collector.reset(new TypeRefCollector(binary.get()));
+    collector->runBatched(1);
+  } catch (const CrefError& e) {
+    fprintf(stderr, "%s\n", e.what());
+    exit(1);
+  }
+  const vector<uint64_t>& types = collector->types;
+  const vector<uint64_t>& refs = collector->refs;
+  printf("%zu types, %zu lookups\n", types.size(), refs.size());
+
+  double best_map_insert = 1e9, best_map_find = 1e9;
+  double best_index_insert = 1e9, best_index_find = 1e9;
+  for (int trial = 0; trial < 5; trial++) {
+    double start = now();
+    map<uint64_t, uint32_t> m;
+    for (size_t i = 0; i < types.size(); i++)
+      m.insert(make_pair(types[i], (uint32_t)i));
+    double map_insert = now() - start;
+
+    start = now();
+    uint64_t map_sum = 0;
+    for (size_t i = 0; i < refs.size(); i++) {
+      map<uint64_t, uint32_t>::const_iterator found = m.find(refs[i]);
+      map_sum += found != m.end() ? found->second : OffsetIndex::NOT_FOUND;
+    }
+    double map_find = now() - start;
+
+    start = now();
+    OffsetIndex index;
+    for (size_t i = 0; i < types.size(); i++)
+      index.add(types[i]);
+    double index_insert = now() - start;
+
+    start = now();
+    uint64_t index_sum = 0;
+    for (size_t i = 0; i < refs.size(); i++)
+      index_sum += index.find(refs[i]);
+    double index_find = now() - start;
+
+    if (map_sum != index_sum) {
+      fprintf(stderr, "lookup mismatch\n");
+      return 1;
+    }
+
+    best_map_insert = min(best_map_insert, map_insert);
+    best_map_find = min(best_map_find, map_find);
+    best_index_insert = min(best_index_insert, index_insert);
+    best_index_find = min(best_index_find, index_find);
+  }
+
+  printf("%-8s %14s %14s %8s\n",
+         "op", "map (M/s)", "index (M/s)", "speedup");
+  printf("%-8s %14.1f %14.1f %7.2fx\n", "insert",
+         types.size() / best_map_insert / 1e6,
+         types.size() / best_index_insert / 1e6,
+         best_map_insert / best_index_insert);
+  printf("%-8s %14.1f %14.1f %7.2fx\n", "find",
+         refs.size() / best_map_find / 1e6,
+         refs.size() / best_index_find / 1e6,
+         best_map_find / best_index_find);
+}
@@ -0,0 +1,142 @@
+#ifndef TYPE_TABLE_H_
+#define TYPE_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <functional>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Hash-conses types by structure, so that a type which is defined again
+// in every CU that uses it gets one ID for all of them. A type is its
+// kind, name and size, the ID of the type it refers to and the ID of a
+// list, such as the parameters of a function type, so types must be
+// interned bottom-up. Names are compared by content and must outlive the
+// table.
+class TypeTable {
+public:
+  static const uint32_t NONE = 0xffffffff;
+
+  struct Entry {
+    const char* name;
+    int32_t size;
+    // The ID of the referred type, or NONE.
+    uint32_t ref;
+    // The ID of a list from internList(), or NONE.
+    uint32_t list;
+    uint8_t type;
+  };
+
+  TypeTable()
+    : ids_(0, Hash(this), Equal(this)),
+      list_ids_(0, ListHash(this), ListEqual(this)) {
+  }
+
+  TypeTable(const TypeTable&) = delete;
+  TypeTable& operator=(const TypeTable&) = delete;
+
+  size_t size() const { return entries_.size(); }
+  const Entry& get(uint32_t id) const { return entries_[id]; }
+
+  // Returns the ID of the type, which is new if no equal type was interned.
+  uint32_t intern(uint8_t type, const char* name, int32_t size,
+                  uint32_t ref, uint32_t list = NONE) {
+    // The candidate is looked up in place and dropped if it is known.
+    uint32_t id = entries_.size();
+    entries_.push_back(Entry{ name, size, ref, list, type });
+    std::pair<std::unordered_set<uint32_t, Hash, Equal>::iterator, bool>
+      inserted = ids_.insert(id);
+    if (!inserted.second)
+      entries_.pop_back();
+    return *inserted.first;
+  }
+
+  // Returns the ID of the list of |size| values at |items|, which are
+  // usually IDs of types.
+  uint32_t internList(const uint32_t* items, size_t size) {
+    uint32_t id = lists_.size();
+    lists_.push_back(List{ (uint32_t)list_items_.size(), (uint32_t)size });
+    list_items_.insert(list_items_.end(), items, items + size);
+    std::pair<std::unordered_set<uint32_t, ListHash, ListEqual>::iterator,
+              bool> inserted = list_ids_.insert(id);
+    if (!inserted.second) {
+      lists_.pop_back();
+      list_items_.resize(list_items_.size() - size);
+    }
+    return *inserted.first;
+  }
+
+  const uint32_t* getList(uint32_t id, uint32_t* size) const {
+    *size = lists_[id].size;
+    return list_items_.data() + lists_[id].begin;
+  }
+
+private:
+  struct Hash {
+    explicit Hash(const TypeTable* t) : table(t) {}
+    size_t operator()(uint32_t id) const {
+      const Entry& e = table->entries_[id];
+      size_t h = e.name ? std::hash<std::string_view>()(e.name) : 0;
+      h = h * 31 + e.type;
+      h = h * 31 + (uint32_t)e.size;
+      h = h * 31 + e.list;
+      return h * 31 + e.ref;
+    }
+    const TypeTable* table;
+  };
+
+  struct Equal {
+    explicit Equal(const TypeTable* t) : table(t) {}
+    bool operator()(uint32_t a, uint32_t b) const {
+      const Entry& x = table->entries_[a];
+      const Entry& y = table->entries_[b];
+      return (x.type == y.type && x.size == y.size && x.ref == y.ref &&
+              x.list == y.list &&
+              (x.name == y.name ||
+               (x.name && y.name && !strcmp(x.name, y.name))));
+    }
+    const TypeTable* table;
+  };
+
+  struct List {
+    uint32_t begin;
+    uint32_t size;
+  };
+
+  struct ListHash {
+    explicit ListHash(const TypeTable* t) : table(t) {}
+    size_t operator()(uint32_t id) const {
+      const List& l = table->lists_[id];
+      size_t h = l.size;
+      for (uint32_t i = 0; i < l.size; i++)
+        h = h * 31 + table->list_items_[l.begin + i];
+      return h;
+    }
+    const TypeTable* table;
+  };
+
+  struct ListEqual {
+    explicit ListEqual(const TypeTable* t) : table(t) {}
+    bool operator()(uint32_t a, uint32_t b) const {
+      const List& x = table->lists_[a];
+      const List& y = table->lists_[b];
+      const uint32_t* items = table->list_items_.data();
+      return (x.size == y.size &&
+              (!x.size || !memcmp(items + x.begin, items + y.begin,
+                                  x.size * sizeof(uint32_t))));
+    }
+    const TypeTable* table;
+  };
+
+  std::vector<Entry> entries_;
+  std::unordered_set<uint32_t, Hash, Equal> ids_;
+  std::vector<List> lists_;
+  // The items of all lists, one after another.
+  std::vector<uint32_t> list_items_;
+  std::unordered_set<uint32_t, ListHash, ListEqual> list_ids_;
+};
+
+#endif  // TYPE_TABLE_H_
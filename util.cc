@@ -0,0 +1,32 @@
+#include "util.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace std;
+
+static string stringPrintfV(const char* fmt, va_list ap) {
+  char* str;
+  if (vasprintf(&str, fmt, ap) < 0)
+    throw bad_alloc();
+  string ret(str);
+  free(str);
+  return ret;
+}
+
+string stringPrintf(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  string ret = stringPrintfV(fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+void throwError(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  string msg = stringPrintfV(fmt, ap);
+  va_end(ap);
+  throw CrefError(msg);
+}
@@ -0,0 +1,21 @@
+#ifndef UTIL_H_
+#define UTIL_H_
+
+#include <stdexcept>
+#include <string>
+
+// Thrown for binaries we cannot read, with a message for the user.
+class CrefError : public std::runtime_error {
+public:
+  explicit CrefError(const std::string& msg)
+    : std::runtime_error(msg) {
+  }
+};
+
+std::string stringPrintf(const char* fmt, ...)
+  __attribute__((format(printf, 1, 2)));
+
+[[noreturn]] void throwError(const char* fmt, ...)
+  __attribute__((format(printf, 1, 2)));
+
+#endif  // UTIL_H_